@@ -0,0 +1,306 @@
+//
+// Renders the spot scene through Renderer::Draw, which inlines the shaders, and
+// through the std::function fallback, both with nearest filtering, and prints
+// the average frame time of both and the cost of the lazy clear, the cost of
+// transforming the mesh positions one by one and with TransformPoints, the
+// cost of the model out of view drawn and culled by DrawVisible, the cost of
+// culling 10000 objects with a BVH and one by one, the cost of the model split
+// into about 256 meshes drawn by DrawVisible, along with Draw<VS, FS> under 4x
+// MSAA, with an HDR target, with each texture filter near and far, with the
+// texture stored as RGBA8, BC1 and BC3, and with forward and deferred shading
+// with 1 to 4096 lights.
+//
+// usage: Engine_Hou_Bench [frames] [spot.obj] [spot.jpg]
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "h_spot.h"
+
+constexpr int BenchWidth = 720;
+constexpr int BenchHeight = 480;
+
+template <typename DrawCall>
+double AverageFrameMs(Renderer& renderer, int frames, DrawCall draw) {
+    renderer.Clear();
+    draw();
+    renderer.Flush();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        renderer.Clear();
+        draw();
+        renderer.Flush();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+}
+
+// count lights spread over a box around the model. The radius shrinks with the
+// cube root of the count, so a surface point is reached by about the same
+// number of lights at every count.
+std::vector<PointLight> ScatterLights(int count) {
+    const float extent = 1.5f;
+    const float radius = std::cbrt(8.0f * std::pow(2.0f * extent, 3.0f) / (4.18879f * count));
+    std::mt19937 random(count);
+    std::uniform_real_distribution<float> position(-extent, extent), color(0.2f, 1.0f);
+
+    std::vector<PointLight> lights(count);
+    for (PointLight& light : lights) {
+        light.SetPosition(Vec4{position(random), position(random), position(random), 1.0f});
+        light.SetRadiance(Vec4{color(random), color(random), color(random), 1.0f});
+        light.SetRadius(radius);
+        light.SetIntensity(radius * radius);
+        light.SetFalloff(0.85);
+    }
+    return lights;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 100;
+    const char* objPath = argc > 2 ? argv[2] : "D:/GAMES/spot.obj";
+    const char* texturePath = argc > 3 ? argv[3] : "D:/GAMES/spot.jpg";
+
+    Renderer::Init();
+
+    Loader loader;
+    if (!loader.LoadFile(objPath)) {
+        std::printf("can't load %s\n", objPath);
+        return 1;
+    }
+    FrameBuffer image(texturePath);
+    Texture texture{image};
+    Texture bc1Texture{image, TextureFormat::BC1};
+    Texture bc3Texture{image, TextureFormat::BC3};
+
+    VertexBuffer<MeshVertex> vertices;
+    IndexBuffer indices;
+    std::vector<MeshRange> ranges;
+    Bvh bvh;
+    BuildMeshBuffers(loader.LoadedMeshes, vertices, indices, &ranges);
+    BuildMeshBvh(loader.LoadedMeshes, bvh);
+
+    Renderer renderer(BenchWidth, BenchHeight);
+    renderer.SetFaceCull(CW);
+    renderer.EnableBinning(true);
+    renderer.SetBG(Color4{0.678, 0.847, 0.902, 1.0});
+    renderer.SetambiColor(Vec4{0.55f, 0.55f, 0.55f, 1.0f});
+    renderer.SetdiffColor(Vec4{0.20f, 0.20f, 0.20f, 1.0f});
+    renderer.SetspecColor(Vec4{0.05f, 0.05f, 0.05f, 1.0f});
+    renderer.SetViewport(0, 0, BenchWidth, BenchHeight);
+    renderer.ChangeLight();
+    renderer.ChangeTexture();
+
+    Camera camera(90, BenchWidth / 2.0f, BenchHeight / 2.0f, -0.1f, -5.0f);
+    camera.SetProjection(Persp(Radians(camera.fov), float(camera.weight) / camera.height, camera.near, camera.far));
+    camera.UpdateView();
+    renderer.SetNearPlane(camera.near);
+
+    PointLight light;
+    light.SetPosition(Vec4{2.0f, 2.0f, -2.0f, 1.0f});
+    light.SetRadiance(Vec4{5.0f, 5.0f, 5.0f, 1.0f});
+    light.SetRadius(5.0f);
+    light.SetIntensity(10.0f);
+    light.SetFalloff(0.85);
+    renderer.SetLights({light});
+
+    SpotVertexShader vertexShader;
+    vertexShader.vertices = &vertices;
+    vertexShader.uniforms = renderer.GetUniforms(camera);
+
+    SpotFragmentShader fragmentShader;
+    fragmentShader.renderer = &renderer;
+    fragmentShader.uniforms = vertexShader.uniforms;
+    fragmentShader.texture = &texture;
+    // the std::function path has no derivatives and samples level 0, so both
+    // paths are timed with the filter that doesn't use them
+    fragmentShader.sampler.filter = TextureFilter::Nearest;
+
+    ShaderProgram<SpotVaryings> program;
+    program.vertexShader = vertexShader;
+    program.fragmentShader = fragmentShader;
+
+    double inlined = AverageFrameMs(renderer, frames, [&] {
+        renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+    });
+    RenderStats drawStats = renderer.GetStats();
+    double function = AverageFrameMs(renderer, frames, [&] {
+        renderer.DrawIndexed(program, vertices, indices, indices.Size());
+    });
+
+    renderer.EnableMultisample(true);
+    double multisampled = AverageFrameMs(renderer, frames, [&] {
+        renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+    });
+    renderer.EnableMultisample(false);
+
+    renderer.EnableHdr(true);
+    double hdr = AverageFrameMs(renderer, frames, [&] {
+        renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+    });
+    renderer.EnableHdr(false);
+
+    std::printf("%d frames, %d threads\n", frames, renderer.GetThreadCount());
+    std::printf("Draw<VS, FS>:   %.3f ms/frame\n", inlined);
+    std::printf("std::function:  %.3f ms/frame\n", function);
+    std::printf("speedup:        %.2fx\n", function / inlined);
+    std::printf("clear:          %.3f ms, %llu blocks cleared on first touch\n",
+                drawStats.clearMs, (unsigned long long)drawStats.blocksCleared);
+    std::printf("4x MSAA:        %.3f ms/frame, %.2fx of Draw<VS, FS>\n", multisampled, multisampled / inlined);
+    std::printf("HDR:            %.3f ms/frame, %.2fx of Draw<VS, FS>\n", hdr, hdr / inlined);
+
+    std::vector<Vec4> positions(vertices.Size()), transformed(vertices.Size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = vertices[i].position;
+    }
+    Mat4x4 mvp = renderer.GetUniforms(camera)->modelViewProjection;
+    auto transformNs = [&](auto transform) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            transform();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count() / (double(frames) * positions.size());
+    };
+    double single = transformNs([&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            transformed[i] = mvp * positions[i];
+        }
+    });
+    double batched = transformNs([&] { TransformPoints(mvp, positions.data(), transformed.data(), positions.size()); });
+    std::printf("transform:      %.2f ns/vertex one by one, %.2f ns/vertex with TransformPoints\n", single, batched);
+
+    // looking away from the model
+    Vec3 lookat = camera.lookat;
+    camera.lookat = camera.lookfrom * 2.0f - lookat;
+    camera.UpdateView();
+    vertexShader.uniforms = fragmentShader.uniforms = renderer.GetUniforms(camera);
+    double unculled = AverageFrameMs(renderer, frames, [&] {
+        renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+    });
+    double culled = AverageFrameMs(renderer, frames, [&] {
+        DrawVisible(renderer, camera, bvh, ranges, vertexShader, fragmentShader, vertices, indices);
+    });
+    std::printf("out of view:    %.3f ms/frame drawn, %.3f ms/frame with DrawVisible\n", unculled, culled);
+
+    // objects of up to 2 units over a 40 unit cube around the camera
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f), size(0.05f, 1.0f);
+    std::vector<Bvh::Object> objects(10000);
+    for (Bvh::Object& object : objects) {
+        Vec3 center{position(random), position(random), position(random)};
+        Vec3 half{size(random), size(random), size(random)};
+        object.bounds.Extend(center - half);
+        object.bounds.Extend(center + half);
+        object.sphere = BoundingSphere{center, Len(half)};
+    }
+    Bvh scene;
+    scene.Build(objects);
+    size_t visible = 0;
+    auto cullBegin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        scene.Cull(camera.frustumPlanes, [&](uint32_t) { visible++; });
+    }
+    auto linearBegin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        for (const Bvh::Object& object : objects) {
+            if (!IsOutside(camera.frustumPlanes, object.sphere) &&
+                Classify(camera.frustumPlanes, object.bounds) != Containment::Outside) {
+                visible--;
+            }
+        }
+    }
+    auto linearEnd = std::chrono::steady_clock::now();
+    std::printf("culling:        %zu objects, %.1f us with the BVH, %.1f us one by one%s\n", objects.size(),
+                std::chrono::duration<double, std::micro>(linearBegin - cullBegin).count() / frames,
+                std::chrono::duration<double, std::micro>(linearEnd - linearBegin).count() / frames,
+                visible == 0 ? "" : ", results differ");
+
+    camera.lookat = lookat;
+    camera.UpdateView();
+    vertexShader.uniforms = fragmentShader.uniforms = renderer.GetUniforms(camera);
+
+    // the model split into about 256 meshes of consecutive triangles, all in view
+    const size_t pieces = 256;
+    size_t pieceCount = (indices.Size() / 3 + pieces - 1) / pieces * 3;
+    std::vector<MeshRange> pieceRanges;
+    std::vector<Bvh::Object> pieceObjects;
+    for (size_t first = 0; first < indices.Size(); first += pieceCount) {
+        MeshRange range{first, std::min(pieceCount, indices.Size() - first)};
+        std::vector<Vec3> points;
+        Aabb bounds;
+        for (size_t i = range.first; i < range.first + range.count; i++) {
+            const Vec4& p = vertices[indices[i]].position;
+            points.push_back(Vec3{p.x, p.y, p.z});
+            bounds.Extend(points.back());
+        }
+        pieceRanges.push_back(range);
+        pieceObjects.push_back(Bvh::Object{bounds, SphereAround(bounds, points)});
+    }
+    Bvh pieceBvh;
+    pieceBvh.Build(pieceObjects);
+    size_t drawnPieces = 0;
+    double whole = AverageFrameMs(renderer, frames, [&] {
+        renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+    });
+    double split = AverageFrameMs(renderer, frames, [&] {
+        drawnPieces = DrawVisible(renderer, camera, pieceBvh, pieceRanges, vertexShader, fragmentShader,
+                                  vertices, indices);
+    });
+    std::printf("in view:        %zu of %zu meshes, %.3f ms/frame as one draw, %.3f ms/frame with DrawVisible\n",
+                drawnPieces, pieceRanges.size(), whole, split);
+
+    // the model at its usual distance and 2.25 times as far, minified
+    std::printf("\ntexture filter  near ms  distant ms\n");
+    const char* filterNames[] = {"nearest", "bilinear", "trilinear"};
+    for (int filter = 0; filter < 3; filter++) {
+        fragmentShader.sampler.filter = TextureFilter(filter);
+        double near = AverageFrameMs(renderer, frames, [&] {
+            renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+        });
+        camera.lookfrom.z *= 2.25f;
+        camera.UpdateView();
+        vertexShader.uniforms = fragmentShader.uniforms = renderer.GetUniforms(camera);
+        double distant = AverageFrameMs(renderer, frames, [&] {
+            renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+        });
+        camera.lookfrom.z /= 2.25f;
+        camera.UpdateView();
+        vertexShader.uniforms = fragmentShader.uniforms = renderer.GetUniforms(camera);
+        std::printf("  %-12s %7.3f  %10.3f\n", filterNames[filter], near, distant);
+    }
+    fragmentShader.sampler.filter = TextureFilter::Trilinear;
+
+    std::printf("\ntexture format  MB      ms/frame\n");
+    const Texture* textures[] = {&texture, &bc1Texture, &bc3Texture};
+    const char* formatNames[] = {"RGBA8", "BC1", "BC3"};
+    for (int format = 0; format < 3; format++) {
+        fragmentShader.texture = textures[format];
+        double ms = AverageFrameMs(renderer, frames, [&] {
+            renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+        });
+        std::printf("  %-12s %6.2f  %8.3f\n", formatNames[format], textures[format]->Bytes() / 1048576.0, ms);
+    }
+    fragmentShader.texture = &texture;
+
+    // lights/pixel counts the lights the deferred pass evaluates after culling,
+    // forward shading tests every light at every pixel
+    std::printf("\nlights    forward ms  deferred ms  lights/pixel\n");
+    for (int count = 1; count <= 4096; count *= 4) {
+        renderer.SetLights(ScatterLights(count));
+        double ms[2];
+        for (int deferred = 0; deferred < 2; deferred++) {
+            renderer.EnableDeferred(deferred != 0);
+            ms[deferred] = AverageFrameMs(renderer, frames, [&] {
+                renderer.Draw(vertexShader, fragmentShader, vertices, indices, indices.Size());
+            });
+        }
+        std::printf("  %6d  %10.3f  %11.3f  %12.2f\n", count, ms[0], ms[1], renderer.GetStats().LightsPerPixel());
+    }
+
+    Renderer::Quit();
+    return 0;
+}
@@ -0,0 +1,259 @@
+//
+// BC1 and BC3 encoders and decoders for 4x4 blocks of packed RGBA8 texels.
+//
+
+#ifndef ENGINE_HOU_CLION_H_BLOCKCOMPRESS_H
+#define ENGINE_HOU_CLION_H_BLOCKCOMPRESS_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include "h_framebuffer.h"
+
+constexpr int BlockTexels = 16;     // 4x4, row by row
+constexpr int BC1BlockBytes = 8;    // 2 565 endpoints, 2 bit indices
+constexpr int BC3BlockBytes = 16;   // 2 8 bit alpha endpoints and 3 bit indices, then a BC1 color block
+
+inline Uint32 PackTexel(int r, int g, int b, int a) {
+    return Uint32(r) << RedShift | Uint32(g) << GreenShift | Uint32(b) << BlueShift | Uint32(a) << AlphaShift;
+}
+
+// 565 color to 8 bit channels, the top bits repeated into the low ones
+inline void Expand565(uint16_t color, int rgb[3]) {
+    int r = color >> 11, g = (color >> 5) & 0x3f, b = color & 0x1f;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+inline uint16_t Round565(const float rgb[3]) {
+    auto quantize = [](float value, int max) { return std::min(std::max(int(value * max / 255.0f + 0.5f), 0), max); };
+    return uint16_t(quantize(rgb[0], 31) << 11 | quantize(rgb[1], 63) << 5 | quantize(rgb[2], 31));
+}
+
+// The colors of a BC1 block. In 4 color mode the 2 inner ones are at thirds,
+// otherwise there is a midpoint and transparent black.
+inline void BC1Palette(uint16_t c0, uint16_t c1, bool fourColor, Uint32 palette[4]) {
+    int a[3], b[3];
+    Expand565(c0, a);
+    Expand565(c1, b);
+    palette[0] = PackTexel(a[0], a[1], a[2], 255);
+    palette[1] = PackTexel(b[0], b[1], b[2], 255);
+    if (fourColor) {
+        palette[2] = PackTexel((2 * a[0] + b[0]) / 3, (2 * a[1] + b[1]) / 3, (2 * a[2] + b[2]) / 3, 255);
+        palette[3] = PackTexel((a[0] + 2 * b[0]) / 3, (a[1] + 2 * b[1]) / 3, (a[2] + 2 * b[2]) / 3, 255);
+    } else {
+        palette[2] = PackTexel((a[0] + b[0]) / 2, (a[1] + b[1]) / 2, (a[2] + b[2]) / 2, 255);
+        palette[3] = 0;
+    }
+}
+
+// The alphas of a BC3 block, 6 interpolated ones when a0 > a1, otherwise 4
+// and 0 and 255.
+inline void BC3AlphaPalette(int a0, int a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; i++) {
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// BC3 color blocks are always in 4 color mode, BC1 ones only when c0 > c1.
+inline void DecodeColorBlock(const Uint8* block, bool alwaysFourColor, Uint32 texels[BlockTexels]) {
+    uint16_t c0 = uint16_t(block[0] | block[1] << 8), c1 = uint16_t(block[2] | block[3] << 8);
+    Uint32 palette[4];
+    BC1Palette(c0, c1, alwaysFourColor || c0 > c1, palette);
+    uint32_t indices = uint32_t(block[4]) | uint32_t(block[5]) << 8 | uint32_t(block[6]) << 16 | uint32_t(block[7]) << 24;
+    for (int i = 0; i < BlockTexels; i++) {
+        texels[i] = palette[(indices >> 2 * i) & 3];
+    }
+}
+
+inline void DecodeBC1Block(const Uint8* block, Uint32 texels[BlockTexels]) {
+    DecodeColorBlock(block, false, texels);
+}
+
+inline void DecodeBC3Block(const Uint8* block, Uint32 texels[BlockTexels]) {
+    int palette[8];
+    BC3AlphaPalette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= uint64_t(block[2 + i]) << 8 * i;
+    }
+
+    DecodeColorBlock(block + 8, true, texels);
+    const Uint32 alphaMask = 0xffu << AlphaShift;
+    for (int i = 0; i < BlockTexels; i++) {
+        texels[i] = (texels[i] & ~alphaMask) | Uint32(palette[(indices >> 3 * i) & 7]) << AlphaShift;
+    }
+}
+
+// Endpoints at the 2 ends of the colors projected on their principal axis,
+// found by power iteration on the covariance. Texels with used[i] false are
+// left out of the fit.
+inline void FitColorEndpoints(const Uint32 texels[BlockTexels], const bool used[BlockTexels],
+                              uint16_t& c0, uint16_t& c1) {
+    float color[BlockTexels][3], mean[3] = {};
+    int count = 0;
+    for (int i = 0; i < BlockTexels; i++) {
+        color[i][0] = float((texels[i] >> RedShift) & 0xff);
+        color[i][1] = float((texels[i] >> GreenShift) & 0xff);
+        color[i][2] = float((texels[i] >> BlueShift) & 0xff);
+        if (used[i]) {
+            for (int c = 0; c < 3; c++) {
+                mean[c] += color[i][c];
+            }
+            count++;
+        }
+    }
+    if (count == 0) {
+        c0 = c1 = 0;
+        return;
+    }
+    for (float& c : mean) {
+        c /= float(count);
+    }
+
+    float covariance[3][3] = {};
+    for (int i = 0; i < BlockTexels; i++) {
+        if (!used[i]) {
+            continue;
+        }
+        float d[3] = {color[i][0] - mean[0], color[i][1] - mean[1], color[i][2] - mean[2]};
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                covariance[r][c] += d[r] * d[c];
+            }
+        }
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int r = 0; r < 3; r++) {
+            next[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] + covariance[r][2] * axis[2];
+        }
+        float scale = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+        if (scale == 0.0f) {
+            break;
+        }
+        for (int r = 0; r < 3; r++) {
+            axis[r] = next[r] / scale;
+        }
+    }
+
+    float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    for (int i = 0; i < BlockTexels; i++) {
+        if (used[i]) {
+            float t = ((color[i][0] - mean[0]) * axis[0] + (color[i][1] - mean[1]) * axis[1] +
+                       (color[i][2] - mean[2]) * axis[2]) / length2;
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+    }
+
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++) {
+        high[c] = mean[c] + axis[c] * hi;
+        low[c] = mean[c] + axis[c] * lo;
+    }
+    c0 = Round565(high);
+    c1 = Round565(low);
+}
+
+// With allowTransparent, texels of alpha below 128 are stored as the
+// transparent entry of a 3 color block.
+inline void EncodeColorBlock(const Uint32 texels[BlockTexels], bool allowTransparent, bool alwaysFourColor,
+                             Uint8* block) {
+    bool opaque[BlockTexels], anyTransparent = false;
+    for (int i = 0; i < BlockTexels; i++) {
+        opaque[i] = !allowTransparent || ((texels[i] >> AlphaShift) & 0xff) >= 128;
+        anyTransparent |= !opaque[i];
+    }
+
+    uint16_t c0, c1;
+    FitColorEndpoints(texels, opaque, c0, c1);
+    if (anyTransparent ? c0 > c1 : c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    bool fourColor = alwaysFourColor || c0 > c1;
+    Uint32 palette[4];
+    BC1Palette(c0, c1, fourColor, palette);
+
+    uint32_t indices = 0;
+    for (int i = 0; i < BlockTexels; i++) {
+        int best = 3;
+        if (opaque[i]) {
+            int bestError = INT32_MAX;
+            for (int p = 0; p < (fourColor ? 4 : 3); p++) {
+                int error = 0;
+                for (int shift : {RedShift, GreenShift, BlueShift}) {
+                    int d = int((texels[i] >> shift) & 0xff) - int((palette[p] >> shift) & 0xff);
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+        }
+        indices |= uint32_t(best) << 2 * i;
+    }
+
+    block[0] = Uint8(c0);
+    block[1] = Uint8(c0 >> 8);
+    block[2] = Uint8(c1);
+    block[3] = Uint8(c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        block[4 + i] = Uint8(indices >> 8 * i);
+    }
+}
+
+inline void EncodeBC1Block(const Uint32 texels[BlockTexels], Uint8* block) {
+    EncodeColorBlock(texels, true, false, block);
+}
+
+inline void EncodeBC3Block(const Uint32 texels[BlockTexels], Uint8* block) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < BlockTexels; i++) {
+        int alpha = int((texels[i] >> AlphaShift) & 0xff);
+        a0 = std::max(a0, alpha);
+        a1 = std::min(a1, alpha);
+    }
+
+    int palette[8];
+    BC3AlphaPalette(a0, a1, palette);
+    uint64_t indices = 0;
+    if (a0 > a1) {
+        for (int i = 0; i < BlockTexels; i++) {
+            int alpha = int((texels[i] >> AlphaShift) & 0xff), best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(palette[p] - alpha) < std::abs(palette[best] - alpha)) {
+                    best = p;
+                }
+            }
+            indices |= uint64_t(best) << 3 * i;
+        }
+    }
+
+    block[0] = Uint8(a0);
+    block[1] = Uint8(a1);
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = Uint8(indices >> 8 * i);
+    }
+    EncodeColorBlock(texels, false, true, block + 8);
+}
+
+#endif //ENGINE_HOU_CLION_H_BLOCKCOMPRESS_H
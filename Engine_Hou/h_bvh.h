@@ -0,0 +1,216 @@
+//
+// Bounding volumes and a bounding volume hierarchy of scene objects, culled
+// against frustum planes before any of their vertices are transformed.
+//
+
+#ifndef ENGINE_HOU_CLION_H_BVH_H
+#define ENGINE_HOU_CLION_H_BVH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "h_matrix.h"
+
+struct Aabb {
+    Vec3 min{FLT_MAX, FLT_MAX, FLT_MAX};
+    Vec3 max{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+    bool Empty() const { return min.x > max.x; }
+
+    Vec3 Center() const { return (min + max) * 0.5f; }
+    Vec3 Size() const { return max - min; }
+
+    void Extend(const Vec3& p) {
+        for (size_t i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+
+    void Extend(const Aabb& box) {
+        if (!box.Empty()) {
+            Extend(box.min);
+            Extend(box.max);
+        }
+    }
+};
+
+struct BoundingSphere {
+    Vec3 center{0, 0, 0};
+    float radius = 0;
+};
+
+// Sphere around the center of the box of points, as far out as the farthest.
+inline BoundingSphere SphereAround(const Aabb& box, const std::vector<Vec3>& points) {
+    BoundingSphere sphere;
+    sphere.center = box.Center();
+    float radius2 = 0;
+    for (const Vec3& p : points) {
+        radius2 = std::max(radius2, Len2(p - sphere.center));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+enum class Containment {
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+// The planes are Vec4{normal, d} with the normal pointing into the volume, as
+// Camera::frustumPlanes, and n·p + d >= 0 inside. A box is outside when its
+// corner farthest along a normal is behind that plane, inside when the corner
+// nearest is in front of all of them.
+inline Containment Classify(const Vec4 (&planes)[6], const Aabb& box) {
+    Containment result = Containment::Inside;
+    for (const Vec4& plane : planes) {
+        Vec3 farthest{plane.x >= 0 ? box.max.x : box.min.x,
+                      plane.y >= 0 ? box.max.y : box.min.y,
+                      plane.z >= 0 ? box.max.z : box.min.z};
+        Vec3 nearest{plane.x >= 0 ? box.min.x : box.max.x,
+                     plane.y >= 0 ? box.min.y : box.max.y,
+                     plane.z >= 0 ? box.min.z : box.max.z};
+        if (plane.x * farthest.x + plane.y * farthest.y + plane.z * farthest.z + plane.w < 0) {
+            return Containment::Outside;
+        }
+        if (plane.x * nearest.x + plane.y * nearest.y + plane.z * nearest.z + plane.w < 0) {
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+// The planes must be normalized.
+inline bool IsOutside(const Vec4 (&planes)[6], const BoundingSphere& sphere) {
+    for (const Vec4& plane : planes) {
+        const Vec3& c = sphere.center;
+        if (plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w < -sphere.radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// World space planes moved into the space m maps to world, so boxes there can
+// be tested without transforming them: a plane p becomes p * m, normalized
+// again.
+inline void TransformPlanes(const Vec4 (&planes)[6], const Mat4x4& m, Vec4 (&out)[6]) {
+    Mat4x4 transposed = Transpose(m);
+    for (int i = 0; i < 6; i++) {
+        Vec4 plane = transposed * planes[i];
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        out[i] = plane / length;
+    }
+}
+
+// Objects are split at the median of their box centers along the longest axis
+// until at most LeafSize are left, so the tree is at most 32 levels deep.
+// Nodes are stored depth first, so the left child of a node follows it, and
+// the objects below a node are one range of the object order.
+class Bvh {
+public:
+    struct Object {
+        Aabb bounds;
+        BoundingSphere sphere;
+    };
+
+    static constexpr uint32_t LeafSize = 4;
+
+    void Build(std::vector<Object> objects) {
+        objects_ = std::move(objects);
+        nodes_.clear();
+        order_.resize(objects_.size());
+        for (uint32_t i = 0; i < order_.size(); i++) {
+            order_[i] = i;
+        }
+        if (!objects_.empty()) {
+            nodes_.reserve(objects_.size() + 1);
+            Split(0, uint32_t(objects_.size()));
+        }
+    }
+
+    size_t ObjectCount() const { return objects_.size(); }
+    size_t NodeCount() const { return nodes_.size(); }
+    const Object& GetObject(uint32_t index) const { return objects_[index]; }
+
+    // Calls visible(index) for every object not outside the planes. Nodes fully
+    // inside hand out all their objects without testing them.
+    template <typename F>
+    void Cull(const Vec4 (&planes)[6], F&& visible) const {
+        if (nodes_.empty()) {
+            return;
+        }
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes_[stack[--top]];
+            Containment containment = Classify(planes, node.bounds);
+            if (containment == Containment::Outside) {
+                continue;
+            }
+            if (containment == Containment::Inside) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    visible(order_[i]);
+                }
+            } else if (node.right == 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const Object& object = objects_[order_[i]];
+                    if (!IsOutside(planes, object.sphere) && Classify(planes, object.bounds) != Containment::Outside) {
+                        visible(order_[i]);
+                    }
+                }
+            } else {
+                stack[top++] = node.right;
+                stack[top++] = uint32_t(&node - nodes_.data()) + 1;
+            }
+        }
+    }
+
+private:
+    struct Node {
+        Aabb bounds;
+        uint32_t first;
+        uint32_t count;
+        uint32_t right;     // 0 for leaves
+    };
+
+    // Returns the index of the node over order_[first, first + count).
+    uint32_t Split(uint32_t first, uint32_t count) {
+        uint32_t index = uint32_t(nodes_.size());
+        nodes_.push_back(Node{Aabb{}, first, count, 0});
+
+        Aabb bounds, centers;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.Extend(objects_[order_[i]].bounds);
+            centers.Extend(objects_[order_[i]].bounds.Center());
+        }
+        nodes_[index].bounds = bounds;
+
+        Vec3 size = centers.Size();
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        // objects all at one point can't be split
+        if (count <= LeafSize || size[axis] <= 0) {
+            return index;
+        }
+
+        uint32_t half = count / 2;
+        std::nth_element(order_.begin() + first, order_.begin() + first + half, order_.begin() + first + count,
+                         [&](uint32_t a, uint32_t b) {
+                             return objects_[a].bounds.Center()[axis] < objects_[b].bounds.Center()[axis];
+                         });
+        Split(first, half);
+        uint32_t right = Split(first + half, count - half);
+        nodes_[index].right = right;
+        return index;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> order_;
+    std::vector<Object> objects_;
+};
+
+#endif //ENGINE_HOU_CLION_H_BVH_H
@@ -5,6 +5,8 @@
 #ifndef ENGINE_HOU_CLION_H_cameraH
 #define ENGINE_HOU_CLION_H_cameraH
 
+#include <atomic>
+#include <cstdint>
 #include "h_math.h"
 
 class Camera{
@@ -20,75 +22,75 @@ public:
     Vec3 lookat   = {0.0f, 0.0f, 1.0f};
     Vec3   up     = {0.0f, 1.0f, 0.0f};
 
-    Mat4x4 model = Mat4x4::Eye();
-    Mat4x4 view = Mat4x4::Ones();
-    Mat4x4 projection = Mat4x4::Ones();
+    const Mat4x4& GetModel() const { return model; }
+    const Mat4x4& GetView() const { return view; }
+    const Mat4x4& GetProjection() const { return projection; }
+    // inverse transpose of the model's upper 3x3, see NormalMatrix
+    const Mat4x4& GetNormalMatrix() const { return normal; }
+
+    // Models built as RigidMat4x4, by RotateQuaternion or Translate say, get
+    // their normal matrix without an inverse.
+    void SetModel(const Mat4x4& m) { SetModel(m, NormalMatrix(m)); }
+    void SetModel(const RigidMat4x4& m) { SetModel(m, NormalMatrix(m)); }
+
+    // view matrix from lookfrom, lookat and up
+    void UpdateView() {
+        view = View(lookfrom, lookat, up);
+        calculateFrustumPlanes();
+        version = NextVersion();
+    }
 
+    void SetProjection(const Mat4x4& p) {
+        projection = p;
+        calculateFrustumPlanes();
+        version = NextVersion();
+    }
+
+    // Changes with every matrix set on any camera, so data derived from one
+    // can be cached against it.
+    uint64_t Version() const { return version; }
+
+    // World space planes of the view frustum, left, right, bottom, top, far
+    // and near, normalized and facing in. The setters of view and projection
+    // keep them current.
     void calculateFrustumPlanes() {
         Mat4x4 vp = projection * view;
+        auto row = [&](size_t y) { return Vec4{vp.Get(0, y), vp.Get(1, y), vp.Get(2, y), vp.Get(3, y)}; };
+        Vec4 w = row(3);
+        for (int i = 0; i < 3; i++) {
+            frustumPlanes[2 * i] = w + row(i);
+            frustumPlanes[2 * i + 1] = w - row(i);
+        }
 
-        frustumPlanes[0] = Vec4{
-                vp.Get(3, 0) + vp.Get( 0, 0),
-                vp.Get(3, 1) + vp.Get( 0, 1),
-                vp.Get(3, 2) + vp.Get( 0, 2),
-                vp.Get(3, 3) + vp.Get( 0, 3)
-        };
-
-
-        frustumPlanes[1] = Vec4{
-                vp.Get(3, 0) - vp.Get(0, 0),
-                vp.Get(3, 1) - vp.Get(0, 1),
-                vp.Get(3, 2) - vp.Get(0, 2),
-                vp.Get(3, 3) - vp.Get(0, 3)
-        };
-
-
-        frustumPlanes[2] = Vec4{
-                vp.Get(3, 0) + vp.Get(1, 0),
-                vp.Get(3, 1) + vp.Get(1, 1),
-                vp.Get(3, 2) + vp.Get(1, 2),
-                vp.Get(3, 3) + vp.Get(1, 3)
-        };
-
-
-        frustumPlanes[3] = Vec4{
-                vp.Get(3, 0) - vp.Get(1, 0),
-                vp.Get(3, 1) - vp.Get(1, 1),
-                vp.Get(3, 2) - vp.Get(1, 2),
-                vp.Get(3, 3) - vp.Get(1, 3)
-        };
-
-/*        frustumPlanes[4] = Vec4{
-                vp.Get(3, 0) + vp.Get(2, 0),
-                vp.Get(3, 1) + vp.Get(2, 1),
-                vp.Get(3, 2) + vp.Get(2, 2),
-                vp.Get(3, 3) + vp.Get(2, 3)
-        };
-
-        frustumPlanes[5] = Vec4{
-                vp.Get(3, 0) - vp.Get(2, 0),
-                vp.Get(3, 1) - vp.Get(2, 1),
-                vp.Get(3, 2) - vp.Get(2, 2),
-                vp.Get(3, 3) - vp.Get(2, 3)
-        };*/
-
-        for (int i = 0; i < 4; ++i) {
-            float length = std::sqrt(
-                    frustumPlanes[i].x * frustumPlanes[i].x +
-                    frustumPlanes[i].y * frustumPlanes[i].y +
-                    frustumPlanes[i].z * frustumPlanes[i].z
-            );
-            frustumPlanes[i].x /= length;
-            frustumPlanes[i].y /= length;
-            frustumPlanes[i].z /= length;
-            frustumPlanes[i].w /= length;
+        // -w <= x <= w and so on, unless clip w is negative in front of the
+        // camera, as with a negative near plane, then all the planes face out.
+        Vec4 center = Inverse(vp) * Vec4{0, 0, 0, 1};
+        float side = center.w < 0 ? -1.0f : 1.0f;
+        for (Vec4& plane : frustumPlanes) {
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            plane = plane * (side / length);
         }
+    }
+
+private:
 
-        frustumPlanes[4] = Vec4{0, 0, 1, -1.0f + near};
-        frustumPlanes[5] = Vec4{0, 0, -1, -far};
+    void SetModel(const Mat4x4& m, const Mat4x4& n) {
+        model = m;
+        normal = n;
+        version = NextVersion();
+    }
 
+    static uint64_t NextVersion() {
+        static std::atomic<uint64_t> next{1};
+        return next++;
     }
 
+    Mat4x4 model = Mat4x4::Eye();
+    Mat4x4 normal = Mat4x4::Eye();
+    Mat4x4 view = Mat4x4::Ones();
+    Mat4x4 projection = Mat4x4::Ones();
+    uint64_t version = NextVersion();
+
 public:
 
     Vec4 frustumPlanes[6];
@@ -0,0 +1,82 @@
+//
+// Homogeneous clip space clipping of triangles.
+//
+
+#ifndef ENGINE_HOU_CLION_H_CLIP_H
+#define ENGINE_HOU_CLION_H_CLIP_H
+
+#include "h_math.h"
+
+// Screen positions beyond this many pixels around the viewport are clipped,
+// everything inside is left to the integer rasterizer and the scissor.
+constexpr float GuardBandPixels = 8192.0f;
+
+// near plane, the four guard band planes, and the triangle itself
+constexpr int MaxClipVertices = 3 + 5;
+
+enum ClipPlane {
+    ClipNear = 0,
+    ClipFar,
+    ClipLeft,
+    ClipRight,
+    ClipBottom,
+    ClipTop,
+    ClipGuardLeft,
+    ClipGuardRight,
+    ClipGuardBottom,
+    ClipGuardTop,
+    ClipPlaneCount,
+};
+
+// Clip space half-spaces dot(plane, pos4) >= 0. wSign is the sign of w in front
+// of the camera, guardX and guardY the guard band extent in NDC units.
+inline void BuildClipPlanes(float wSign, float guardX, float guardY, Vec4 (&planes)[ClipPlaneCount]) {
+    float s = wSign;
+    planes[ClipNear] = Vec4{0, 0, -s, s};
+    planes[ClipFar] = Vec4{0, 0, s, s};
+    planes[ClipLeft] = Vec4{s, 0, 0, s};
+    planes[ClipRight] = Vec4{-s, 0, 0, s};
+    planes[ClipBottom] = Vec4{0, s, 0, s};
+    planes[ClipTop] = Vec4{0, -s, 0, s};
+    planes[ClipGuardLeft] = Vec4{s, 0, 0, s * guardX};
+    planes[ClipGuardRight] = Vec4{-s, 0, 0, s * guardX};
+    planes[ClipGuardBottom] = Vec4{0, s, 0, s * guardY};
+    planes[ClipGuardTop] = Vec4{0, -s, 0, s * guardY};
+}
+
+// bit i set when the point is outside plane i
+inline uint32_t ClipOutcode(const Vec4& pos, const Vec4 (&planes)[ClipPlaneCount]) {
+    uint32_t code = 0;
+    for (int i = 0; i < ClipPlaneCount; i++) {
+        if (Dot(planes[i], pos) < 0) {
+            code |= 1u << i;
+        }
+    }
+    return code;
+}
+
+template <typename V>
+inline void LerpVertex(const VertexT<V>& a, const VertexT<V>& b, float t, VertexT<V>& out) {
+    out.pos4 = a.pos4 + (b.pos4 - a.pos4) * t;
+    LerpVaryings(a.varyings, b.varyings, t, out.varyings);
+}
+
+// One Sutherland-Hodgman step, returns the vertex count written to out.
+template <typename V>
+inline int ClipPolygon(const VertexT<V>* in, int count, const Vec4& plane, VertexT<V>* out) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const VertexT<V>& a = in[i];
+        const VertexT<V>& b = in[(i + 1) % count];
+        float da = Dot(plane, a.pos4), db = Dot(plane, b.pos4);
+        if (da >= 0) {
+            out[n++] = a;
+        }
+        if ((da >= 0) != (db >= 0)) {
+            LerpVertex(a, b, da / (da - db), out[n++]);
+        }
+    }
+    return n;
+}
+
+#endif //ENGINE_HOU_CLION_H_CLIP_H
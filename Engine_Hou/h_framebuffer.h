@@ -7,9 +7,215 @@
 
 #define Log(fmt, ...) printf("%s[%s: %d]: " fmt "\n", __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
 
+#include <array>
+#include <cfloat>
+#include <vector>
+
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_image.h"
 #include "h_math.h"
+#include "h_simd.h"
+
+// raster block and bin tile edge lengths in pixels
+constexpr int RasterBlockSize = 8;
+constexpr int TileSize = 64;
+
+// Offset of pixel (x, y) in a buffer of 8x8 raster blocks stored one after the
+// other, blocksX per row. Pixels of a block are row-major, so a block, and each
+// of its rows, is contiguous.
+inline size_t TiledIndex(int x, int y, int blocksX) {
+    unsigned bx = unsigned(x) / RasterBlockSize, by = unsigned(y) / RasterBlockSize;
+    return (size_t(by) * blocksX + bx) * (RasterBlockSize * RasterBlockSize) +
+           (unsigned(y) % RasterBlockSize) * RasterBlockSize + unsigned(x) % RasterBlockSize;
+}
+
+constexpr int RasterBlockPixels = RasterBlockSize * RasterBlockSize;
+
+// Generation stamps of the 8x8 blocks of a tiled buffer. Clear only moves the
+// generation, a block is stale until Touch stamps it again.
+class BlockStamps {
+public:
+    BlockStamps(int blocksX, int blocksY): stamps_(size_t(blocksX) * blocksY, 0) {}
+
+    void Clear() {
+        if (++generation_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+    bool Resident(size_t block) const { return stamps_[block] == generation_; }
+
+    // true when the block was stale and has to be filled by the caller
+    bool Touch(size_t block) {
+        if (stamps_[block] == generation_) {
+            return false;
+        }
+        stamps_[block] = generation_;
+        return true;
+    }
+
+private:
+    uint32_t generation_ = 1;
+    std::vector<uint32_t> stamps_;
+};
+
+// 2D buffer stored in TiledIndex order with a lazy clear: Clear is O(1) and a
+// block takes the clear value when Touch makes it resident. Get, Set and Span
+// expect the block of (x, y) to be resident.
+template <typename T>
+class TiledBuffer {
+public:
+    TiledBuffer(int w, int h)
+            : w_(w), h_(h), blocksX_((w + RasterBlockSize - 1) / RasterBlockSize),
+              data_(size_t(blocksX_) * ((h + RasterBlockSize - 1) / RasterBlockSize) * RasterBlockPixels),
+              stamps_(blocksX_, (h + RasterBlockSize - 1) / RasterBlockSize) {}
+
+    void Clear(T value) {
+        clearValue_ = value;
+        stamps_.Clear();
+    }
+
+    // returns true when the block of (x, y) was filled with the clear value
+    bool Touch(int x, int y) {
+        size_t block = Block(x, y);
+        if (!stamps_.Touch(block)) {
+            return false;
+        }
+        std::fill_n(&data_[block * RasterBlockPixels], RasterBlockPixels, clearValue_);
+        return true;
+    }
+
+    bool Resident(int x, int y) const { return stamps_.Resident(Block(x, y)); }
+    T ClearValue() const { return clearValue_; }
+
+    T& Get(int x, int y) { return data_[TiledIndex(x, y, blocksX_)]; }
+    T Get(int x, int y) const { return data_[TiledIndex(x, y, blocksX_)]; }
+    void Set(int x, int y, T value) { data_[TiledIndex(x, y, blocksX_)] = value; }
+
+    // pixel (x, y), followed by the rest of its row inside the block
+    T* Span(int x, int y) { return &data_[TiledIndex(x, y, blocksX_)]; }
+    const T* Span(int x, int y) const { return &data_[TiledIndex(x, y, blocksX_)]; }
+
+    int Width() const { return w_; }
+    int Height() const { return h_; }
+
+private:
+    size_t Block(int x, int y) const {
+        return size_t(unsigned(y) / RasterBlockSize) * blocksX_ + unsigned(x) / RasterBlockSize;
+    }
+
+    int w_;
+    int h_;
+    int blocksX_;
+    std::vector<T> data_;
+    BlockStamps stamps_;
+    T clearValue_ = T();
+};
+
+using Buffer2D = TiledBuffer<float>;
+
+// Pixels are RGBA8 in memory order, the layout of SDL_PIXELFORMAT_RGBA32, so they
+// are packed and unpacked here instead of through the SDL pixel format.
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+constexpr int RedShift = 24, GreenShift = 16, BlueShift = 8, AlphaShift = 0;
+#else
+constexpr int RedShift = 0, GreenShift = 8, BlueShift = 16, AlphaShift = 24;
+#endif
+
+// channel in [0, 1] to unorm8, truncating like the Uint8 conversion SDL_MapRGBA got
+inline Uint32 UnormChannel(float value) {
+    value *= 255;
+    // NaN fails the compare and comes out as 0
+    return Uint32(value > 0 ? std::min(value, 255.0f) : 0.0f);
+}
+
+inline Uint32 PackRGBA8(const Color4& color) {
+    return UnormChannel(color.r) << RedShift | UnormChannel(color.g) << GreenShift |
+           UnormChannel(color.b) << BlueShift | UnormChannel(color.a) << AlphaShift;
+}
+
+inline Color4 UnpackRGBA8(Uint32 pixel) {
+    return Color4{float((pixel >> RedShift) & 0xff) / 255.0f, float((pixel >> GreenShift) & 0xff) / 255.0f,
+                  float((pixel >> BlueShift) & 0xff) / 255.0f, float((pixel >> AlphaShift) & 0xff) / 255.0f};
+}
+
+// PackRGBA8 of the 8 lanes of color, into out[0..7]
+inline void PackRGBA8(const Vec4x8& color, Uint32* out) {
+#if defined(ENGINE_HOU_AVX2)
+    auto channel = [](Float8 value, int shift) {
+        Float8 scaled = Min(Max(value * 255.0f, 0.0f), 255.0f);
+        return _mm256_slli_epi32(_mm256_cvttps_epi32(scaled.v), shift);
+    };
+    __m256i packed = _mm256_or_si256(_mm256_or_si256(channel(color.x, RedShift), channel(color.y, GreenShift)),
+                                     _mm256_or_si256(channel(color.z, BlueShift), channel(color.w, AlphaShift)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+#else
+    for (int lane = 0; lane < SimdWidth; lane++) {
+        out[lane] = PackRGBA8(Color4{color.x.v[lane], color.y.v[lane], color.z.v[lane], color.w.v[lane]});
+    }
+#endif
+}
+
+// Narkowicz's fit of the ACES filmic curve, linear HDR to [0, 1]. NaN maps
+// to 0 and infinity, where the ratio is NaN, to 1, as the Float8 Min and Max
+// do.
+inline float ToneMapAces(float x) {
+    x = x > 0 ? x : 0.0f;
+    float mapped = x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f);
+    return mapped < 1.0f ? mapped : 1.0f;
+}
+
+inline Float8 ToneMapAces(Float8 x) {
+    x = Max(x, 0.0f);
+    return Min(x * (x * 2.51f + 0.03f) / (x * (x * 2.43f + 0.59f) + 0.14f), 1.0f);
+}
+
+// sRGB encoded unorm8 of a linear value in [0, 1], at value * (SrgbLutSize - 1)
+// rounded to nearest
+constexpr int SrgbLutSize = 4096;
+
+inline const int32_t* SrgbLut() {
+    static const std::array<int32_t, SrgbLutSize> lut = [] {
+        std::array<int32_t, SrgbLutSize> table{};
+        for (int i = 0; i < SrgbLutSize; i++) {
+            float v = float(i) / (SrgbLutSize - 1);
+            float encoded = v <= 0.0031308f ? 12.92f * v : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+            table[i] = int32_t(encoded * 255.0f + 0.5f);
+        }
+        return table;
+    }();
+    return lut.data();
+}
+
+// exposure, tonemap and sRGB encoding of one linear channel
+inline Uint32 EncodeHdrChannel(float linear, float exposure) {
+    int index = int(ToneMapAces(linear * exposure) * (SrgbLutSize - 1) + 0.5f);
+    return Uint32(SrgbLut()[std::min(std::max(index, 0), SrgbLutSize - 1)]);
+}
+
+inline Uint32 EncodeHdr(const Color4& color, float exposure) {
+    return EncodeHdrChannel(color.r, exposure) << RedShift | EncodeHdrChannel(color.g, exposure) << GreenShift |
+           EncodeHdrChannel(color.b, exposure) << BlueShift | UnormChannel(color.a) << AlphaShift;
+}
+
+// Linear color that EncodeHdr turns into the RGBA8 pixel of display, so HDR
+// clears come out as the display background. Every byte is reached since the
+// encoding is continuous and rises from 0 to 255.
+inline Color4 DecodeHdr(const Color4& display, float exposure) {
+    float result[3];
+    const float channels[3] = {display.r, display.g, display.b};
+    for (int c = 0; c < 3; c++) {
+        Uint32 target = UnormChannel(channels[c]);
+        float low = 0.0f, high = 16.0f / std::max(exposure, 1e-6f);
+        for (int i = 0; i < 64; i++) {
+            float middle = 0.5f * (low + high);
+            (EncodeHdrChannel(middle, exposure) < target ? low : high) = middle;
+        }
+        result[c] = high;
+    }
+    return Color4{result[0], result[1], result[2], display.a};
+}
 
 class FrameBuffer final {
 public:
@@ -38,25 +244,89 @@ public:
     inline int Height() const { return m_frameBuffer->h; }
     inline Vec2 Size() const { return {float(m_frameBuffer->w), float(m_frameBuffer->h)}; }
     void PutPixel(int x, int y, const Color4 &color) {
-        *getPixel(x, y) = SDL_MapRGBA(m_frameBuffer->format, color.r * 255,
-                                      color.g * 255, color.b * 255, color.a * 255);
+        *getPixel(x, y) = PackRGBA8(color);
     }
 
-    Color4 GetPixel(int x, int y) const {
-        const Uint32 *color = getPixel(x, y);
-        Uint8 r, g, b, a;
-        SDL_GetRGBA(*color, m_frameBuffer->format, &r, &g, &b, &a);
-        return Color4{r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
+    void PutRaw(int x, int y, Uint32 value) {
+        *getPixel(x, y) = value;
     }
 
-    inline void Clear(const Color4 &color) {
-        SDL_FillRect(m_frameBuffer, nullptr,
-                     SDL_MapRGBA(m_frameBuffer->format, color.r * 255, color.g * 255,
-                                 color.b * 255, color.a * 255));
+    // first RGBA8 pixel of row y
+    Uint32* Row(int y) { return getPixel(0, y); }
+    const Uint32* Row(int y) const { return getPixel(0, y); }
+
+    // Copies [x0, x1) x [y0, y1) of a tiled buffer of RGBA8 pixels to the
+    // surface, x0 being a multiple of RasterBlockSize. Blocks left stale since
+    // the last Clear are written with the clear value without being read.
+    void Detile(const TiledBuffer<Uint32>& source, int x0, int y0, int x1, int y1) {
+        Uint32 clear = source.ClearValue();
+        for (int y = y0; y < y1; y++) {
+            Uint32* row = Row(y);
+            const Uint32* span = source.Span(x0, y);
+            for (int x = x0; x < x1; x += RasterBlockSize, span += RasterBlockPixels) {
+                int count = std::min(RasterBlockSize, x1 - x);
+                if (!source.Resident(x, y)) {
+                    std::fill_n(row + x, count, clear);
+                } else if (count == RasterBlockSize) {
+                    for (int i = 0; i < RasterBlockSize; i++) {
+                        row[x + i] = span[i];
+                    }
+                } else {
+                    std::copy_n(span, count, row + x);
+                }
+            }
+        }
     }
 
+    // Tonemaps [x0, x1) x [y0, y1) of a tiled linear HDR buffer into the surface,
+    // x0 being a multiple of RasterBlockSize. Blocks left stale since the last
+    // Clear are written as clear. Two pixels, 8 channels, go through the curve at once.
+    void ResolveHdr(const TiledBuffer<Color4>& source, float exposure, Uint32 clear,
+                    int x0, int y0, int x1, int y1) {
+        for (int y = y0; y < y1; y++) {
+            Uint32* row = Row(y);
+            for (int bx = x0; bx < x1; bx += RasterBlockSize) {
+                int end = std::min(bx + RasterBlockSize, x1);
+                if (!source.Resident(bx, y)) {
+                    std::fill(row + bx, row + end, clear);
+                    continue;
+                }
+                const Color4* span = source.Span(bx, y);
+                int x = bx;
+#if defined(ENGINE_HOU_AVX2) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+                static_assert(sizeof(Color4) == 4 * sizeof(float), "two pixels per vector");
+                const __m256 scale = _mm256_setr_ps(exposure, exposure, exposure, 1.0f,
+                                                    exposure, exposure, exposure, 1.0f);
+                for (; x + 2 <= end; x += 2, span += 2) {
+                    __m256 linear = _mm256_mul_ps(_mm256_loadu_ps(&span[0].x), scale);
+                    Float8 mapped = ToneMapAces(Float8(linear)) * float(SrgbLutSize - 1) + 0.5f;
+                    __m256i encoded = _mm256_i32gather_epi32(SrgbLut(), _mm256_cvttps_epi32(mapped.v), 4);
+                    Float8 alpha = Min(Max(Float8(linear) * 255.0f, 0.0f), 255.0f);
+                    __m256i pixels = _mm256_blend_epi32(encoded, _mm256_cvttps_epi32(alpha.v), 0x88);
+                    pixels = _mm256_packus_epi16(_mm256_packus_epi32(pixels, pixels), pixels);
+                    row[x] = Uint32(_mm256_cvtsi256_si32(pixels));
+                    row[x + 1] = Uint32(_mm256_extract_epi32(pixels, 4));
+                }
+#endif
+                for (; x < end; x++, span++) {
+                    row[x] = EncodeHdr(*span, exposure);
+                }
+            }
+        }
+    }
+
+    Color4 GetPixel(int x, int y) const {
+        return UnpackRGBA8(*getPixel(x, y));
+    }
 
+    inline void Clear(const Color4 &color) {
+        Uint32 value = PackRGBA8(color);
+        for (int y = 0; y < Height(); y++) {
+            std::fill_n(getPixel(0, y), Width(), value);
+        }
+    }
 
+    // the surface, for handing the frame to SDL when presenting
     SDL_Surface* GetRaw() const { return m_frameBuffer; }
 
 private:
@@ -64,47 +334,231 @@ private:
 
     Uint32 *getPixel(int x, int y) const {
         Uint8 *ptr = (Uint8 *)m_frameBuffer->pixels;
-        return (Uint32 *)(ptr + y * m_frameBuffer->pitch +
-                          x * m_frameBuffer->format->BytesPerPixel);
+        return (Uint32 *)(ptr + y * m_frameBuffer->pitch) + x;
     }
 };
 
-class Buffer2D {
+constexpr int MsaaSamples = 4;
+
+// Rotated grid sample positions relative to the pixel center, in 1/16 pixel.
+constexpr int MsaaSampleOffsets[MsaaSamples][2] = {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}};
+constexpr int MsaaSampleReach = 6;
+
+// 4x multisample color and depth, the samples of a pixel stored next to each
+// other and the pixels in TiledIndex order. Colors are packed RGBA8. Cleared
+// lazily per block like TiledBuffer.
+class MultisampleBuffer {
 public:
-    Buffer2D(int w, int h): w_(w), h_(h) {
-        data_ = new float[w * h];
-        Fill(0);
+    MultisampleBuffer(int w, int h)
+            : w_(w), h_(h), blocksX_((w + RasterBlockSize - 1) / RasterBlockSize),
+              color_(size_t(blocksX_) * ((h + RasterBlockSize - 1) / RasterBlockSize) *
+                     RasterBlockPixels * MsaaSamples),
+              depth_(color_.size()),
+              stamps_(blocksX_, (h + RasterBlockSize - 1) / RasterBlockSize) {}
+
+    void Clear(Uint32 color, float depth) {
+        clearColor_ = color;
+        clearDepth_ = depth;
+        stamps_.Clear();
     }
 
-    void Fill(float value) {
-        for (int i = 0; i < w_ * h_; i++) {
-            data_[i] = value;
+    // returns true when the block of (x, y) was filled with the clear values
+    bool Touch(int x, int y) {
+        size_t block = Block(x, y);
+        if (!stamps_.Touch(block)) {
+            return false;
         }
+        size_t first = block * RasterBlockPixels * MsaaSamples;
+        std::fill_n(&color_[first], RasterBlockPixels * MsaaSamples, clearColor_);
+        std::fill_n(&depth_[first], RasterBlockPixels * MsaaSamples, clearDepth_);
+        return true;
     }
 
-    float& Get(int x, int y) {
-        return data_[x * h_ + y];
+    Uint32* Color(int x, int y) { return &color_[TiledIndex(x, y, blocksX_) * MsaaSamples]; }
+    float* Depth(int x, int y) { return &depth_[TiledIndex(x, y, blocksX_) * MsaaSamples]; }
+
+    // Averages the samples of [x0, x1) x [y0, y1) into target, channel by channel,
+    // x0 being a multiple of RasterBlockSize. The even and odd bytes are summed
+    // apart so every 16 bit sum has room for the carry.
+    void Resolve(FrameBuffer& target, int x0, int y0, int x1, int y1) const {
+        static_assert(MsaaSamples == 4, "the resolve divides by shifting");
+        for (int y = y0; y < y1; y++) {
+            Uint32* row = target.Row(y);
+            for (int bx = x0; bx < x1; bx += RasterBlockSize) {
+                int end = std::min(bx + RasterBlockSize, x1);
+                if (!stamps_.Resident(Block(bx, y))) {
+                    std::fill(row + bx, row + end, clearColor_);
+                    continue;
+                }
+                const Uint32* samples = &color_[TiledIndex(bx, y, blocksX_) * MsaaSamples];
+                for (int x = bx; x < end; x++, samples += MsaaSamples) {
+                    if (samples[0] == samples[1] && samples[0] == samples[2] && samples[0] == samples[3]) {
+                        row[x] = samples[0];
+                        continue;
+                    }
+                    Uint32 even = 0x00020002, odd = 0x00020002;
+                    for (int s = 0; s < MsaaSamples; s++) {
+                        even += samples[s] & 0x00ff00ff;
+                        odd += (samples[s] >> 8) & 0x00ff00ff;
+                    }
+                    row[x] = ((even >> 2) & 0x00ff00ff) | (((odd >> 2) & 0x00ff00ff) << 8);
+                }
+            }
+        }
     }
 
-    float Get(int x, int y) const {
-        return data_[x * h_ + y];
+    int Width() const { return w_; }
+    int Height() const { return h_; }
+
+private:
+    size_t Block(int x, int y) const {
+        return size_t(unsigned(y) / RasterBlockSize) * blocksX_ + unsigned(x) / RasterBlockSize;
     }
 
-    void Set(int x, int y, float value) {
-        data_[x * h_ + y] = value;
+    int w_;
+    int h_;
+    int blocksX_;
+    std::vector<Uint32> color_;
+    std::vector<float> depth_;
+    BlockStamps stamps_;
+    Uint32 clearColor_ = 0;
+    float clearDepth_ = 0;
+};
+
+struct VisibilityID {
+    uint32_t drawID;
+    uint32_t triangleID;
+};
+
+constexpr uint32_t InvalidDrawID = 0xffffffffu;
+
+// Per pixel (draw, triangle) of the nearest fragment, for deferred shading.
+class VisibilityBuffer {
+public:
+    VisibilityBuffer(int w, int h): w_(w), h_(h), data_(size_t(w) * h) {
+        Clear();
     }
 
+    void Clear() {
+        std::fill(data_.begin(), data_.end(), VisibilityID{InvalidDrawID, 0});
+    }
+
+    const VisibilityID& Get(int x, int y) const { return data_[size_t(y) * w_ + x]; }
+    void Set(int x, int y, const VisibilityID& id) { data_[size_t(y) * w_ + x] = id; }
+
     int Width() const { return w_; }
     int Height() const { return h_; }
 
-    ~Buffer2D() {
-        delete[] data_;
+private:
+    int w_;
+    int h_;
+    std::vector<VisibilityID> data_;
+};
+
+// Surface attributes of the nearest fragment, written by the geometry pass of
+// deferred shading and lit once per pixel afterwards.
+struct GBufferTexel {
+    Vec3 normal;
+    Vec3 position;
+    Color4 albedo;
+    float specular;
+    float shininess;
+};
+
+class GBuffer {
+public:
+    GBuffer(int w, int h): w_(w), h_(h), data_(size_t(w) * h), written_(size_t(w) * h) {
+        Clear();
+    }
+
+    void Clear() {
+        std::fill(written_.begin(), written_.end(), 0);
+    }
+
+    bool Written(int x, int y) const { return written_[size_t(y) * w_ + x] != 0; }
+    const GBufferTexel& Get(int x, int y) const { return data_[size_t(y) * w_ + x]; }
+    void Set(int x, int y, const GBufferTexel& texel) {
+        data_[size_t(y) * w_ + x] = texel;
+        written_[size_t(y) * w_ + x] = 1;
+    }
+    // the pixel got a forward shaded color instead
+    void Erase(int x, int y) { written_[size_t(y) * w_ + x] = 0; }
+
+    int Width() const { return w_; }
+    int Height() const { return h_; }
+
+private:
+    int w_;
+    int h_;
+    std::vector<GBufferTexel> data_;
+    std::vector<uint8_t> written_;
+};
+
+// Two level depth pyramid over a Buffer2D: the farthest depth of every 8x8
+// raster block and of every 64x64 tile. Larger depth is nearer, so a
+// triangle whose nearest depth is not above these values is hidden there.
+class HiZBuffer {
+public:
+    HiZBuffer(int w, int h)
+            : w_(w), h_(h),
+              blocksX_((w + RasterBlockSize - 1) / RasterBlockSize),
+              blocksY_((h + RasterBlockSize - 1) / RasterBlockSize),
+              tilesX_((w + TileSize - 1) / TileSize),
+              tilesY_((h + TileSize - 1) / TileSize),
+              blocks_(blocksX_ * blocksY_),
+              tiles_(tilesX_ * tilesY_) {
+        Fill(0);
+    }
+
+    void Fill(float value) {
+        std::fill(blocks_.begin(), blocks_.end(), value);
+        std::fill(tiles_.begin(), tiles_.end(), value);
+    }
+
+    float Block(int bx, int by) const { return blocks_[by * blocksX_ + bx]; }
+    float Tile(int tx, int ty) const { return tiles_[ty * tilesX_ + tx]; }
+
+    // Refreshes a block after depth writes inside it, and its tile when needed.
+    void UpdateBlock(const Buffer2D& depth, int bx, int by) {
+        int x0 = bx * RasterBlockSize, x1 = std::min(x0 + RasterBlockSize, w_),
+                y0 = by * RasterBlockSize, y1 = std::min(y0 + RasterBlockSize, h_);
+        float farthest = FLT_MAX;
+        for (int y = y0; y < y1; y++) {
+            const float* row = depth.Span(x0, y);
+            for (int x = 0; x < x1 - x0; x++) {
+                farthest = std::min(farthest, row[x]);
+            }
+        }
+
+        float& block = blocks_[by * blocksX_ + bx];
+        float old = block;
+        block = farthest;
+
+        int tx = x0 / TileSize, ty = y0 / TileSize;
+        float& tile = tiles_[ty * tilesX_ + tx];
+        if (old != tile) {
+            return;
+        }
+        const int span = TileSize / RasterBlockSize;
+        int bx1 = std::min((tx + 1) * span, blocksX_),
+                by1 = std::min((ty + 1) * span, blocksY_);
+        tile = FLT_MAX;
+        for (int j = ty * span; j < by1; j++) {
+            for (int i = tx * span; i < bx1; i++) {
+                tile = std::min(tile, blocks_[j * blocksX_ + i]);
+            }
+        }
     }
 
 private:
-    float* data_;
     int w_;
     int h_;
+    int blocksX_;
+    int blocksY_;
+    int tilesX_;
+    int tilesY_;
+    std::vector<float> blocks_;
+    std::vector<float> tiles_;
 };
 
 #endif //ENGINE_HOU_CLION_H_framebufferH
@@ -5,7 +5,8 @@
 #ifndef ENGINE_HOU_CLION_H_LIGHT_H
 #define ENGINE_HOU_CLION_H_LIGHT_H
 
-#include "h_vector.h"
+#include "h_math.h"
+#include "h_simd.h"
 
 struct PointLight
 {
@@ -24,4 +25,65 @@ struct PointLight
     void SetRadius(const float &c) { Radius = c; }
     void SetFalloff(const float &c) { Falloff = c; }
 };
+
+// Lights add nothing from their radius on, so shaders skip them there.
+inline bool InRange(const PointLight& light, const Vec3& position) {
+    Vec3 lightPos = Vec3{light.Position.x, light.Position.y, light.Position.z};
+    return Len2(lightPos - position) < light.Radius * light.Radius;
+}
+
+// InRange of 8 points, bit i set for lane i
+inline uint32_t InRange(const PointLight& light, const Vec3x8& position) {
+    Vec3x8 lightPos = Splat(Vec3{light.Position.x, light.Position.y, light.Position.z});
+    return LessMask(Len2(lightPos - position), light.Radius * light.Radius);
+}
+
+// Blinn-Phong contribution of one light at a surface point with unit normal N.
+inline Vec4 PointLightShading(const PointLight& light, const Vec3& position, const Vec3& N, const Vec3& eye,
+                              const Vec4& ks, float shininess, const Vec4& diffColor, const Vec4& specColor) {
+    Vec3 lightPos = Vec3{light.Position.x, light.Position.y, light.Position.z};
+
+    Vec3 L = Normalize(position - lightPos);
+    Vec3 V = Normalize(eye - position);
+    Vec3 H = Normalize(L + V);
+
+    float specular = std::pow(std::abs(Dot(H, N)), shininess);
+
+    float lambertian = std::abs(Dot(L, N));
+    float distance2 = Len2(lightPos - position);
+    float radius2 = light.Radius * light.Radius;
+
+    float falloff = Clamp(1.0f - distance2 / radius2, 0.0f, 1.0f) * light.Falloff;
+    float intensity = light.Intensity / distance2;
+
+    Vec4 spec = ks * specular * intensity * specColor;
+    Vec4 diff = lambertian * intensity * diffColor;
+
+    return falloff * light.Radiance * (spec + diff);
+}
+
+// The same for the 8 surface points of a SoA batch, the light, eye and
+// material shared by all of them.
+inline Vec4x8 PointLightShading(const PointLight& light, const Vec3x8& position, const Vec3x8& N, const Vec3& eye,
+                                const Vec4& ks, float shininess, const Vec4& diffColor, const Vec4& specColor) {
+    Vec3x8 lightPos = Splat(Vec3{light.Position.x, light.Position.y, light.Position.z});
+
+    Vec3x8 L = Normalize(position - lightPos);
+    Vec3x8 V = Normalize(Splat(eye) - position);
+    Vec3x8 H = Normalize(L + V);
+
+    Float8 specular = Pow(Abs(Dot(H, N)), shininess);
+
+    Float8 lambertian = Abs(Dot(L, N));
+    Float8 distance2 = Len2(lightPos - position);
+    float radius2 = light.Radius * light.Radius;
+
+    Float8 falloff = Clamp(Float8(1.0f) - distance2 / radius2, 0.0f, 1.0f) * light.Falloff;
+    Float8 intensity = Float8(light.Intensity) / distance2;
+
+    Vec4x8 spec = Splat(ks) * specular * intensity * Splat(specColor);
+    Vec4x8 diff = lambertian * intensity * Splat(diffColor);
+
+    return falloff * Splat(light.Radiance) * (spec + diff);
+}
 #endif //ENGINE_HOU_CLION_H_LIGHT_H
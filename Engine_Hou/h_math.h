@@ -8,6 +8,8 @@
 #define H_PI 3.141f
 #define H_PI_DEGREE 180.0f
 
+#include <cmath>
+
 #include "h_matrix.h"
 #include "h_vertex.h"
 
@@ -43,7 +45,7 @@ Quaternion eulerToQuaternion(float roll, float pitch, float yaw) {
     return q;
 }
 
-Mat4x4 RotateQuaternion(const Quaternion& q) {
+RigidMat4x4 RotateQuaternion(const Quaternion& q) {
 
     float xx = q.x * q.x;
     float yy = q.y * q.y;
@@ -55,13 +57,13 @@ Mat4x4 RotateQuaternion(const Quaternion& q) {
     float yz = q.y * q.z;
     float xw = q.x * q.w;
 
-    return Mat4x4 {
+    return RigidMat4x4(Mat4x4 {
             1 - 2 * (yy + zz), 2 * (xy + zw),      2 * (zx - yw),     0,
             2 * (xy - zw),     1 - 2 * (xx + zz),  2 * (yz + xw),     0,
             2 * (zx + yw),     2 * (yz - xw),      1 - 2 * (xx + yy), 0,
             0,                 0,                  0,                 1,
 
-    };
+    });
 }
 
 Vec3 NormalizeEuler(Vec3 angle) {
@@ -85,27 +87,26 @@ inline int Sign(T value) {
 }
 
 
-inline Mat4x4 View(Vec3 eye, Vec3 center, Vec3 up){
-    Mat4x4 Result;
+inline RigidMat4x4 View(Vec3 eye, Vec3 center, Vec3 up){
     Vec3 const f(Normalize(center - eye));
     Vec3 const s(Normalize(Cross(f, up)));
     Vec3 const u(Cross(s, f));
 
-    return Mat4x4{
+    return RigidMat4x4(Mat4x4{
             -s.x,       -s.y,      -s.z,    Dot(s, eye),
             -u.x,       -u.y,      -u.z,    Dot(u, eye),
             -f.x,       -f.y,      -f.z,    Dot(f, eye),
             0,         0,        0,         1,
-    };
+    });
 }
 
-inline Mat4x4 Ortho(float l, float r, float b, float t, float n, float f) {
-    return Mat4x4{
+constexpr AffineMat4x4 Ortho(float l, float r, float b, float t, float n, float f) {
+    return AffineMat4x4(Mat4x4{
             2 / (r - l), 0,           0, -(l + r) / (r - l),
             0, 2 / (t - b),           0, -(t + b) / (t - b),
             0,           0, 2 / (n - f), -(n + f) / (n - f),
             0,           0,           0,            1,
-    };
+    });
 }
 
 inline Mat4x4 Persp(float fov, float aspect, float near, float far) {
@@ -119,47 +120,47 @@ inline Mat4x4 Persp(float fov, float aspect, float near, float far) {
     };
 }
 
-inline Mat4x4 Translate(float x, float y, float z) {
-    return Mat4x4{
+constexpr RigidMat4x4 Translate(float x, float y, float z) {
+    return RigidMat4x4(Mat4x4{
             1, 0, 0, x,
             0, 1, 0, y,
             0, 0, 1, z,
             0, 0, 0, 1
-    };
+    });
 }
 
-inline Mat4x4 RotateEuler(float x, float y, float z) {
+inline RigidMat4x4 RotateEuler(float x, float y, float z) {
     float sinx = std::sin(x),
             cosx = std::cos(x),
             siny = std::sin(y),
             cosy = std::cos(y),
             sinz = std::sin(z),
             cosz = std::cos(z);
-    return Mat4x4{
+    return RigidMat4x4(Mat4x4{
             cosz, -sinz, 0, 0,
             sinz,  cosz, 0, 0,
             0,     0, 1, 0,
             0,     0, 0, 1,
-    } * Mat4x4{
+    }) * RigidMat4x4(Mat4x4{
             cosy, 0, siny, 0,
             0, 1,    0, 0,
             -siny, 0, cosy, 0,
             0, 0,    0, 1
-    } * Mat4x4{
+    }) * RigidMat4x4(Mat4x4{
             1,    0,     0, 0,
             0, cosx, -sinx, 0,
             0, sinx,  cosx, 0,
             0,    0,     0, 1
-    };
+    });
 }
 
-inline Mat4x4 Scale(float x, float y, float z) {
-    return Mat4x4{
+constexpr AffineMat4x4 Scale(float x, float y, float z) {
+    return AffineMat4x4(Mat4x4{
             x, 0, 0, 0,
             0, y, 0, 0,
             0, 0, z, 0,
             0, 0, 0, 1
-    };
+    });
 }
 
 inline std::ostream& operator<<(std::ostream& o, const Rect& r) {
@@ -183,21 +184,6 @@ T SmoothStep(T edge0, T edge1, float t) {
     return t * t * (3 - 2 * t);
 }
 
-inline bool isPointInFrustum(const Vec4& point,const Vec4 (&frustumPlanes)[6]) {
-
-    for (int i = 0; i < 6; ++i) {
-        const Vec4& plane = frustumPlanes[i];
-
-        float distance = plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w;
-        if (distance < -0.5f) {
-            return false;
-        }
-    }
-    return true;
-}
-
-
-
 inline bool IsPointInRect(const Vec2 &p, const Rect &r) {
     return p.x >= r.pos.x && p.x <= r.pos.x + r.size.w &&
            p.y >= r.pos.y && p.y <= r.pos.y + r.size.h;
@@ -261,6 +247,57 @@ inline Vec3 Barycentric(const TriangleH& t1, const Vec2& p) {
                 result.y / result.z};
 }
 
+inline int64_t FloorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Snaps the screen positions to the sub-pixel grid and builds the edge functions
+// and pixel bounds, returns false for degenerate triangles.
+template <typename V>
+inline bool SetupEdges(TriangleT<V>& tri, int64_t sampleReach = 0) {
+    const VertexT<V>* v = &tri.v1;
+    TriangleEdges& edges = tri.edges;
+
+    int64_t x[3], y[3];
+    for (int i = 0; i < 3; i++) {
+        x[i] = std::llround(v[i].pos3.x * SubPixelScale);
+        y[i] = std::llround(v[i].pos3.y * SubPixelScale);
+    }
+
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0) {
+        return false;
+    }
+    int64_t sign = area > 0 ? 1 : -1;
+    edges.area = area * sign;
+
+    for (int k = 0; k < 3; k++) {
+        int i = (k + 1) % 3, j = (k + 2) % 3;
+        int64_t a = (y[i] - y[j]) * sign,
+                b = (x[j] - x[i]) * sign;
+        bool topLeft = a > 0 || (a == 0 && b > 0);
+        edges.a[k] = a;
+        edges.b[k] = b;
+        edges.bias[k] = topLeft ? 0 : 1;
+        edges.c[k] = -(a * x[i] + b * y[i]) - edges.bias[k];
+    }
+
+    // pixel (px, py) is sampled at its center, px * SubPixelScale + SubPixelScale / 2,
+    // or up to sampleReach subpixels away from it
+    const int64_t half = SubPixelScale / 2;
+    edges.minX = int(FloorDiv(std::min({x[0], x[1], x[2]}) - half - sampleReach + SubPixelScale - 1, SubPixelScale));
+    edges.minY = int(FloorDiv(std::min({y[0], y[1], y[2]}) - half - sampleReach + SubPixelScale - 1, SubPixelScale));
+    edges.maxX = int(FloorDiv(std::max({x[0], x[1], x[2]}) - half + sampleReach, SubPixelScale)) + 1;
+    edges.maxY = int(FloorDiv(std::max({y[0], y[1], y[2]}) - half + sampleReach, SubPixelScale)) + 1;
+    return true;
+}
+
+// edge k at the center of pixel (x, y)
+inline int64_t EvaluateEdge(const TriangleEdges& edges, int k, int x, int y) {
+    return edges.a[k] * (x * SubPixelScale + SubPixelScale / 2) +
+           edges.b[k] * (y * SubPixelScale + SubPixelScale / 2) + edges.c[k];
+}
+
 inline Rect AABB(const TriangleH& tri) {
 
     Vec2 v1 = tri.v1.pos2;
@@ -5,40 +5,42 @@
 #ifndef ENGINE_HOU_CLION_H_MATRIX_H
 #define ENGINE_HOU_CLION_H_MATRIX_H
 
+#include <cmath>
+#include <type_traits>
+#include <utility>
 #include "h_vector.h"
 
-template <size_t Col, size_t Row> class Matrix {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define ENGINE_HOU_SSE 1
+#endif
+
+// Elements are stored column by column, 4x4 matrices 16 byte aligned so each
+// column loads as one SSE vector.
+template <size_t Col, size_t Row> class alignas(Col == 4 && Row == 4 ? 16 : alignof(float)) Matrix {
 public:
     static Matrix Zero;
     static Matrix One;
 
     Matrix() = default;
 
-    Matrix(float value) {
+    constexpr Matrix(float value) : data_{} {
         for (auto &elem : data_) {
             elem = value;
         }
     }
 
-    Matrix(const std::initializer_list<float> &l) {
-        for (size_t i = 0; i < l.size(); i++) {
-            Set(i % Col, i / Col, *(l.begin() + i));
-        }
-    }
+    // All Col * Row elements, written row by row.
+    template <typename... T, typename = std::enable_if_t<sizeof...(T) == Col * Row && (Col * Row > 1)>>
+    constexpr Matrix(T... values) : Matrix(std::make_index_sequence<Col * Row>(), {float(values)...}) {}
 
-    Matrix(const std::initializer_list<Vector<Row>> &l) {
-        for (size_t i = 0; i < l.size(); i++) {
-            auto it = l.begin();
-            for (size_t j = 0; j < Row; i++) {
-                Set(i, j, *(l.begin() + j));
-            }
-        }
-    }
+    constexpr float Get(size_t x, size_t y) const { return data_[y + x * Row]; }
+    constexpr float& Get(size_t x, size_t y) { return data_[y + x * Row]; }
 
-    float Get(size_t x, size_t y) const { return data_[y + x * Row]; }
-    float& Get(size_t x, size_t y) { return data_[y + x * Row]; }
+    constexpr void Set(size_t x, size_t y, float value) { data_[y + x * Row] = value; }
 
-    void Set(size_t x, size_t y, float value) { data_[y + x * Row] = value; }
+    constexpr const float* Data() const { return data_; }
+    constexpr float* Data() { return data_; }
 
     Matrix operator*(float value) const {
         Matrix result = *this;
@@ -118,11 +120,11 @@ public:
         return *this;
     }
 
-    static Matrix Ones() { return Matrix(1); }
+    static constexpr Matrix Ones() { return Matrix(1); }
 
-    static Matrix Zeros() { return Matrix(0); }
+    static constexpr Matrix Zeros() { return Matrix(0); }
 
-    static Matrix Eye() {
+    static constexpr Matrix Eye() {
         static_assert(Col == Row);
 
         Matrix<Col, Col> result(0);
@@ -141,6 +143,11 @@ public:
     }
 
 private:
+    // Element I of the column-major storage from the row-major list.
+    template <size_t... I>
+    constexpr Matrix(std::index_sequence<I...>, const float (&rows)[Col * Row])
+            : data_{rows[I % Row * Col + I / Row]...} {}
+
     float data_[Col * Row];
 };
 
@@ -191,15 +198,28 @@ Matrix<Row, Col> Transpose(const Matrix<Col, Row> &m) {
 }
 
 
+// Gauss-Jordan on columns with partial pivoting. The 4x4 matrices have closed
+// forms below.
 template <size_t Col, size_t Row>
 Matrix<Row, Col> Inverse(const Matrix<Row, Col> &m) {
-    Matrix<Row, Col> inverse = Matrix<Row, Col>::Ones();
+    Matrix<Row, Col> inverse = Matrix<Row, Col>::Eye();
     Matrix<Row, Col> temp = m;
 
     for (size_t i = 0; i < Row; ++i) {
-        float pivot = temp.Get(i, i);
-        //if (fabs(pivot) < 1e-6) throw std::runtime_error("Matrix is singular!");
+        size_t best = i;
+        for (size_t k = i + 1; k < Row; ++k) {
+            if (std::abs(temp.Get(k, i)) > std::abs(temp.Get(best, i))) {
+                best = k;
+            }
+        }
+        if (best != i) {
+            for (size_t j = 0; j < Col; ++j) {
+                std::swap(temp.Get(i, j), temp.Get(best, j));
+                std::swap(inverse.Get(i, j), inverse.Get(best, j));
+            }
+        }
 
+        float pivot = temp.Get(i, i);
         for (size_t j = 0; j < Col; ++j) {
             temp.Set(i, j, temp.Get(i, j) / pivot);
             inverse.Set(i, j, inverse.Get(i, j) / pivot);
@@ -237,4 +257,204 @@ using Mat2x2 = Matrix<2, 2>;
 using Mat3x3 = Matrix<3, 3>;
 using Mat4x4 = Matrix<4, 4>;
 
+static_assert(std::is_trivially_copyable<Mat4x4>::value && sizeof(Mat4x4) == 16 * sizeof(float) &&
+              alignof(Mat4x4) == 16);
+static_assert(std::is_trivially_copyable<Mat3x3>::value && sizeof(Mat3x3) == 9 * sizeof(float));
+static_assert(Mat4x4::Eye().Get(3, 3) == 1 && Mat4x4::Eye().Get(3, 0) == 0);
+
+// SSE forms of the 4x4 products and transpose, picked over the templates above
+// by overload resolution. They sum the columns in the same order as the loops.
+#if defined(ENGINE_HOU_SSE)
+
+inline __m128 Transform(const Mat4x4 &m, __m128 v) {
+    const float *c = m.Data();
+    __m128 r = _mm_mul_ps(_mm_load_ps(c), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(c + 4), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(c + 8), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(c + 12), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+    return r;
+}
+
+inline Vector<4> operator*(const Mat4x4 &m, const Vector<4> &v) {
+    Vector<4> result;
+    _mm_store_ps(result.data, Transform(m, _mm_load_ps(v.data)));
+    return result;
+}
+
+inline Mat4x4 operator*(const Mat4x4 &m1, const Mat4x4 &m2) {
+    Mat4x4 result;
+    for (int j = 0; j < 4; j++) {
+        _mm_store_ps(result.Data() + 4 * j, Transform(m1, _mm_load_ps(m2.Data() + 4 * j)));
+    }
+    return result;
+}
+
+inline Mat4x4 Transpose(const Mat4x4 &m) {
+    __m128 c0 = _mm_load_ps(m.Data()), c1 = _mm_load_ps(m.Data() + 4),
+            c2 = _mm_load_ps(m.Data() + 8), c3 = _mm_load_ps(m.Data() + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    Mat4x4 result;
+    _mm_store_ps(result.Data(), c0);
+    _mm_store_ps(result.Data() + 4, c1);
+    _mm_store_ps(result.Data() + 8, c2);
+    _mm_store_ps(result.Data() + 12, c3);
+    return result;
+}
+
+#endif
+
+// out[i] = m * in[i] for n points, in and out may be the same array. With AVX
+// two points go through at once, each in one 128 bit half.
+inline void TransformPoints(const Mat4x4 &m, const Vector<4> *in, Vector<4> *out, size_t n) {
+    size_t i = 0;
+#if defined(__AVX__)
+    const float *c = m.Data();
+    __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(c)),
+            c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(c + 4)),
+            c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(c + 8)),
+            c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(c + 12));
+    for (; i + 2 <= n; i += 2) {
+        __m256 v = _mm256_loadu_ps(in[i].data);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(out[i].data, r);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = m * in[i];
+    }
+}
+
+// General 4x4 inverse from the 2x2 minors of the top and bottom row pairs.
+// m must not be singular.
+inline Mat4x4 Inverse(const Mat4x4 &m) {
+    auto a = [&](int row, int col) { return m.Get(col, row); };
+
+    float s0 = a(0, 0) * a(1, 1) - a(1, 0) * a(0, 1);
+    float s1 = a(0, 0) * a(1, 2) - a(1, 0) * a(0, 2);
+    float s2 = a(0, 0) * a(1, 3) - a(1, 0) * a(0, 3);
+    float s3 = a(0, 1) * a(1, 2) - a(1, 1) * a(0, 2);
+    float s4 = a(0, 1) * a(1, 3) - a(1, 1) * a(0, 3);
+    float s5 = a(0, 2) * a(1, 3) - a(1, 2) * a(0, 3);
+
+    float c5 = a(2, 2) * a(3, 3) - a(3, 2) * a(2, 3);
+    float c4 = a(2, 1) * a(3, 3) - a(3, 1) * a(2, 3);
+    float c3 = a(2, 1) * a(3, 2) - a(3, 1) * a(2, 2);
+    float c2 = a(2, 0) * a(3, 3) - a(3, 0) * a(2, 3);
+    float c1 = a(2, 0) * a(3, 2) - a(3, 0) * a(2, 2);
+    float c0 = a(2, 0) * a(3, 1) - a(3, 0) * a(2, 1);
+
+    float invDet = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+    return Mat4x4{
+            ( a(1, 1) * c5 - a(1, 2) * c4 + a(1, 3) * c3) * invDet,
+            (-a(0, 1) * c5 + a(0, 2) * c4 - a(0, 3) * c3) * invDet,
+            ( a(3, 1) * s5 - a(3, 2) * s4 + a(3, 3) * s3) * invDet,
+            (-a(2, 1) * s5 + a(2, 2) * s4 - a(2, 3) * s3) * invDet,
+
+            (-a(1, 0) * c5 + a(1, 2) * c2 - a(1, 3) * c1) * invDet,
+            ( a(0, 0) * c5 - a(0, 2) * c2 + a(0, 3) * c1) * invDet,
+            (-a(3, 0) * s5 + a(3, 2) * s2 - a(3, 3) * s1) * invDet,
+            ( a(2, 0) * s5 - a(2, 2) * s2 + a(2, 3) * s1) * invDet,
+
+            ( a(1, 0) * c4 - a(1, 1) * c2 + a(1, 3) * c0) * invDet,
+            (-a(0, 0) * c4 + a(0, 1) * c2 - a(0, 3) * c0) * invDet,
+            ( a(3, 0) * s4 - a(3, 1) * s2 + a(3, 3) * s0) * invDet,
+            (-a(2, 0) * s4 + a(2, 1) * s2 - a(2, 3) * s0) * invDet,
+
+            (-a(1, 0) * c3 + a(1, 1) * c1 - a(1, 2) * c0) * invDet,
+            ( a(0, 0) * c3 - a(0, 1) * c1 + a(0, 2) * c0) * invDet,
+            (-a(3, 0) * s3 + a(3, 1) * s1 - a(3, 2) * s0) * invDet,
+            ( a(2, 0) * s3 - a(2, 1) * s1 + a(2, 2) * s0) * invDet,
+    };
+}
+
+// Column col of the upper 3x3 of m.
+inline Vec3 Column3(const Mat4x4 &m, size_t col) {
+    return Vec3{m.Get(col, 0), m.Get(col, 1), m.Get(col, 2)};
+}
+
+// Inverse transpose of the upper 3x3 of m, in a 4x4 that leaves w alone. Its
+// columns are the cross products of the columns of m over the determinant.
+inline Mat4x4 NormalMatrix(const Mat4x4 &m) {
+    Vec3 c0 = Column3(m, 0), c1 = Column3(m, 1), c2 = Column3(m, 2);
+    Vec3 n0 = Cross(c1, c2), n1 = Cross(c2, c0), n2 = Cross(c0, c1);
+    float invDet = 1.0f / Dot(c0, n0);
+    return Mat4x4{
+            n0.x * invDet, n1.x * invDet, n2.x * invDet, 0,
+            n0.y * invDet, n1.y * invDet, n2.y * invDet, 0,
+            n0.z * invDet, n1.z * invDet, n2.z * invDet, 0,
+            0,             0,             0,             1,
+    };
+}
+
+// Inverse of a matrix whose last row is 0 0 0 1. The rows of the inverse of
+// the upper 3x3 are the same cross products, and the translation is taken
+// back through it.
+inline Mat4x4 InverseAffine(const Mat4x4 &m) {
+    Vec3 c0 = Column3(m, 0), c1 = Column3(m, 1), c2 = Column3(m, 2), t = Column3(m, 3);
+    Vec3 n0 = Cross(c1, c2), n1 = Cross(c2, c0), n2 = Cross(c0, c1);
+    float invDet = 1.0f / Dot(c0, n0);
+    return Mat4x4{
+            n0.x * invDet, n0.y * invDet, n0.z * invDet, -Dot(n0, t) * invDet,
+            n1.x * invDet, n1.y * invDet, n1.z * invDet, -Dot(n1, t) * invDet,
+            n2.x * invDet, n2.y * invDet, n2.z * invDet, -Dot(n2, t) * invDet,
+            0,             0,             0,             1,
+    };
+}
+
+// Inverse of a rotation, or reflection, followed by a translation: the upper
+// 3x3 transposed.
+inline Mat4x4 InverseRigid(const Mat4x4 &m) {
+    Vec3 c0 = Column3(m, 0), c1 = Column3(m, 1), c2 = Column3(m, 2), t = Column3(m, 3);
+    return Mat4x4{
+            c0.x, c0.y, c0.z, -Dot(c0, t),
+            c1.x, c1.y, c1.z, -Dot(c1, t),
+            c2.x, c2.y, c2.z, -Dot(c2, t),
+            0,    0,    0,    1,
+    };
+}
+
+// 4x4 matrices known to be affine or rigid, as made by Translate, Scale,
+// RotateQuaternion, View and the like. They are used as any Mat4x4, while
+// Inverse and NormalMatrix pick the cheap forms for them. Products of two keep
+// the kind. The kind is only in the static type: stored in a plain Mat4x4, as
+// in Mat4x4 r = Translate(t), the matrix is general again.
+class AffineMat4x4 : public Mat4x4 {
+public:
+    AffineMat4x4() = default;
+    constexpr explicit AffineMat4x4(const Mat4x4 &m) : Mat4x4(m) {}
+};
+
+class RigidMat4x4 : public AffineMat4x4 {
+public:
+    RigidMat4x4() = default;
+    constexpr explicit RigidMat4x4(const Mat4x4 &m) : AffineMat4x4(m) {}
+};
+
+inline AffineMat4x4 operator*(const AffineMat4x4 &m1, const AffineMat4x4 &m2) {
+    return AffineMat4x4(static_cast<const Mat4x4 &>(m1) * static_cast<const Mat4x4 &>(m2));
+}
+
+inline RigidMat4x4 operator*(const RigidMat4x4 &m1, const RigidMat4x4 &m2) {
+    return RigidMat4x4(static_cast<const Mat4x4 &>(m1) * static_cast<const Mat4x4 &>(m2));
+}
+
+inline AffineMat4x4 Inverse(const AffineMat4x4 &m) { return AffineMat4x4(InverseAffine(m)); }
+
+inline RigidMat4x4 Inverse(const RigidMat4x4 &m) { return RigidMat4x4(InverseRigid(m)); }
+
+// The upper 3x3 of a rigid matrix is its own inverse transpose.
+inline Mat4x4 NormalMatrix(const RigidMat4x4 &m) {
+    Vec3 c0 = Column3(m, 0), c1 = Column3(m, 1), c2 = Column3(m, 2);
+    return Mat4x4{
+            c0.x, c1.x, c2.x, 0,
+            c0.y, c1.y, c2.y, 0,
+            c0.z, c1.z, c2.z, 0,
+            0,    0,    0,    1,
+    };
+}
+
 #endif //ENGINE_HOU_CLION_H_MATRIX_H
@@ -11,6 +11,7 @@
 #include <fstream>
 #include <math.h>
 #include <sstream>
+#include "h_bvh.h"
 
 
 #define OBJL_CONSOLE_OUTPUT
@@ -189,6 +190,20 @@ struct Mesh
     {
         Vertices = _Vertices;
         Indices = _Indices;
+        ComputeBounds();
+    }
+    // Box and sphere around the vertex positions
+    void ComputeBounds()
+    {
+        std::vector<Vec3> positions;
+        positions.reserve(Vertices.size());
+        Bounds = Aabb{};
+        for (const VertexLoad& v : Vertices)
+        {
+            positions.push_back(Vec3{v.Position.X, v.Position.Y, v.Position.Z});
+            Bounds.Extend(positions.back());
+        }
+        Sphere = SphereAround(Bounds, positions);
     }
     // Mesh Name
     std::string MeshName;
@@ -196,6 +211,9 @@ struct Mesh
     std::vector<VertexLoad> Vertices;
     // Index List
     std::vector<unsigned int> Indices;
+    // Bounding Volumes
+    Aabb Bounds;
+    BoundingSphere Sphere;
 
     // Material
     Material MeshMaterial;
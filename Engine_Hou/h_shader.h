@@ -7,7 +7,10 @@
 
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <type_traits>
 #include "h_framebuffer.h"
+#include "h_simd.h"
 
 
 float Clamp(float value, float min, float max) {
@@ -28,17 +31,187 @@ struct ShaderContext {
     }
 };
 
-using VertexShader = std::function<Vec4(int index, ShaderContext &output)>;
-using FragmentShader = std::function<Vec4(ShaderContext &input)>;
+// Varyings are either a ShaderContext or a plain struct of floats, which is
+// interpolated as a flat float array without touching the heap.
+template <typename V>
+inline void InterpolateVaryings(const V& a, const V& b, const V& c, const Vec3& weight, V& out) {
+    static_assert(std::is_trivially_copyable<V>::value && sizeof(V) % sizeof(float) == 0,
+                  "varyings must be a struct of floats");
+    constexpr size_t count = sizeof(V) / sizeof(float);
+    const auto* fa = reinterpret_cast<const float*>(&a);
+    const auto* fb = reinterpret_cast<const float*>(&b);
+    const auto* fc = reinterpret_cast<const float*>(&c);
+    auto* fo = reinterpret_cast<float*>(&out);
+    for (size_t i = 0; i < count; i++) {
+        fo[i] = fa[i] * weight.alpha + fb[i] * weight.beta + fc[i] * weight.gamma;
+    }
+}
 
+// V8 is the SoA form of V, a Float8 for every float of V in the same order.
+template <typename V, typename V8>
+inline void InterpolateVaryings8(const V& a, const V& b, const V& c,
+                                 Float8 alpha, Float8 beta, Float8 gamma, V8& out) {
+    constexpr size_t count = sizeof(V) / sizeof(float);
+    static_assert(sizeof(V8) == count * sizeof(Float8), "V8 must hold one Float8 per float of V");
+    const auto* fa = reinterpret_cast<const float*>(&a);
+    const auto* fb = reinterpret_cast<const float*>(&b);
+    const auto* fc = reinterpret_cast<const float*>(&c);
+    auto* fo = reinterpret_cast<Float8*>(&out);
+    for (size_t i = 0; i < count; i++) {
+        fo[i] = Float8(fa[i]) * alpha + Float8(fb[i]) * beta + Float8(fc[i]) * gamma;
+    }
+}
 
-inline Color4 TextureSample(const FrameBuffer* const surface, Vec2 varyingVec2) {
-    varyingVec2.x = Clamp(varyingVec2.x, 0, 1);
-    varyingVec2.y = Clamp(varyingVec2.y, 0, 1);
+template <typename V>
+inline void LerpVaryings(const V& a, const V& b, float t, V& out) {
+    static_assert(std::is_trivially_copyable<V>::value && sizeof(V) % sizeof(float) == 0,
+                  "varyings must be a struct of floats");
+    constexpr size_t count = sizeof(V) / sizeof(float);
+    const auto* fa = reinterpret_cast<const float*>(&a);
+    const auto* fb = reinterpret_cast<const float*>(&b);
+    auto* fo = reinterpret_cast<float*>(&out);
+    for (size_t i = 0; i < count; i++) {
+        fo[i] = fa[i] + (fb[i] - fa[i]) * t;
+    }
+}
 
-    return surface->GetPixel(varyingVec2.x * surface->Width(), varyingVec2.y * surface->Height());
+inline void InterpolateVaryings(const ShaderContext& a, const ShaderContext& b, const ShaderContext& c,
+                                const Vec3& weight, ShaderContext& out) {
+    out.Clear();
+    for (auto& [key, value] : a.varyingFloat) {
+        out.varyingFloat[key] = value * weight.alpha + b.varyingFloat.at(key) * weight.beta +
+                                c.varyingFloat.at(key) * weight.gamma;
+    }
+    for (auto& [key, value] : a.varyingVec2) {
+        out.varyingVec2[key] = value * weight.alpha + b.varyingVec2.at(key) * weight.beta +
+                               c.varyingVec2.at(key) * weight.gamma;
+    }
+    for (auto& [key, value] : a.varyingVec3) {
+        out.varyingVec3[key] = value * weight.alpha + b.varyingVec3.at(key) * weight.beta +
+                               c.varyingVec3.at(key) * weight.gamma;
+    }
+    for (auto& [key, value] : a.varyingVec4) {
+        out.varyingVec4[key] = value * weight.alpha + b.varyingVec4.at(key) * weight.beta +
+                               c.varyingVec4.at(key) * weight.gamma;
+    }
 }
 
+inline void LerpVaryings(const ShaderContext& a, const ShaderContext& b, float t, ShaderContext& out) {
+    out.Clear();
+    for (auto& [key, value] : a.varyingFloat) {
+        out.varyingFloat[key] = value + (b.varyingFloat.at(key) - value) * t;
+    }
+    for (auto& [key, value] : a.varyingVec2) {
+        out.varyingVec2[key] = value + (b.varyingVec2.at(key) - value) * t;
+    }
+    for (auto& [key, value] : a.varyingVec3) {
+        out.varyingVec3[key] = value + (b.varyingVec3.at(key) - value) * t;
+    }
+    for (auto& [key, value] : a.varyingVec4) {
+        out.varyingVec4[key] = value + (b.varyingVec4.at(key) - value) * t;
+    }
+}
+
+template <typename V>
+using VertexShaderT = std::function<Vec4(int index, V &output)>;
+template <typename V>
+using FragmentShaderT = std::function<Vec4(V &input)>;
+
+using VertexShader = VertexShaderT<ShaderContext>;
+using FragmentShader = FragmentShaderT<ShaderContext>;
+
+// Shader objects other than std::function are always callable.
+template <typename F>
+inline bool IsShaderSet(const F&) { return true; }
+
+template <typename R, typename... Args>
+inline bool IsShaderSet(const std::function<R(Args...)>& shader) { return bool(shader); }
 
+// A fragment shader with a wide form names its SoA varyings Varyings8 and is
+// also callable as Vec4x8(Varyings8&, uint32_t laneMask) on 8 pixels at once.
+template <typename FS, typename = void>
+struct HasWideShader : std::false_type {};
+
+template <typename FS>
+struct HasWideShader<FS, std::void_t<typename FS::Varyings8>> : std::true_type {};
+
+struct GBufferTexel;
+
+// A fragment shader with a surface form is also callable as
+// void(Varyings&, GBufferTexel&), which fills the G-buffer in deferred mode.
+template <typename FS, typename = void>
+struct HasSurfaceShader : std::false_type {};
+
+template <typename FS>
+struct HasSurfaceShader<FS, std::void_t<decltype(std::declval<const FS&>()(
+        std::declval<typename FS::Varyings&>(), std::declval<GBufferTexel&>()))>> : std::true_type {};
+
+// Per draw constants derived from a camera, see Renderer::GetUniforms. A block
+// is never changed after it is built, so the shaders of a draw read the one
+// they were recorded with from any thread.
+struct Uniforms {
+    Mat4x4 model;
+    Mat4x4 view;
+    Mat4x4 projection;
+    Mat4x4 viewProjection;
+    Mat4x4 modelViewProjection;
+    Mat4x4 normal;      // NormalMatrix of model, for normals with w = 0
+    Vec3 eye;
+};
+
+// A fragment shader with a uniforms member holding such a block records it with
+// its draw, the lighting pass of deferred mode takes the eye from there.
+template <typename FS, typename = void>
+struct HasUniforms : std::false_type {};
+
+template <typename FS>
+struct HasUniforms<FS, std::void_t<decltype(std::shared_ptr<const Uniforms>(std::declval<const FS&>().uniforms))>>
+        : std::true_type {};
+
+// Screen space derivatives of the varyings, taken across the 2x2 pixel quad a
+// pixel belongs to: the varyings of its right and lower quad neighbours minus
+// those of its top-left pixel.
+template <typename V>
+struct QuadDerivatives {
+    V ddx;
+    V ddy;
+};
+
+// A fragment shader with quad forms is also callable as
+// Vec4(Varyings&, const QuadDerivatives<Varyings>&), and its wide and surface
+// forms, if any, take QuadDerivatives after the varyings as well. The renderer
+// then computes the derivatives and prefers those forms, for texture LOD.
+template <typename FS, typename = void>
+struct HasQuadShader : std::false_type {};
+
+template <typename FS>
+struct HasQuadShader<FS, std::void_t<decltype(std::declval<const FS&>()(
+        std::declval<typename FS::Varyings&>(),
+        std::declval<const QuadDerivatives<typename FS::Varyings>&>()))>> : std::true_type {};
+
+// A quad shader may also have bool NeedsDerivatives() const. While it returns
+// false, the renderer skips the derivatives and calls the forms without them.
+template <typename FS, typename = void>
+struct HasDerivativeQuery : std::false_type {};
+
+template <typename FS>
+struct HasDerivativeQuery<FS, std::void_t<decltype(std::declval<const FS&>().NeedsDerivatives())>>
+        : std::true_type {};
+
+template <typename FS>
+inline bool NeedsQuadDerivatives(const FS& shader) {
+    if constexpr (HasDerivativeQuery<FS>::value) {
+        return HasQuadShader<FS>::value && shader.NeedsDerivatives();
+    } else {
+        return HasQuadShader<FS>::value;
+    }
+}
+
+// Shader pair of a draw call with a compile-time varying layout V.
+template <typename V>
+struct ShaderProgram {
+    VertexShaderT<V> vertexShader;
+    FragmentShaderT<V> fragmentShader;
+};
 
 #endif //ENGINE_HOU_CLION_H_SHADER_H
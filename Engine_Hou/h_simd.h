@@ -0,0 +1,202 @@
+//
+// 8-wide float vectors for the SoA fragment path, AVX2 when the compiler targets
+// it and a plain array of lanes otherwise.
+//
+
+#ifndef ENGINE_HOU_CLION_H_SIMD_H
+#define ENGINE_HOU_CLION_H_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+#include "h_vector.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ENGINE_HOU_AVX2 1
+#endif
+
+constexpr int SimdWidth = 8;
+
+#if defined(ENGINE_HOU_AVX2)
+
+struct Float8 {
+    __m256 v;
+
+    Float8() = default;
+    Float8(__m256 value): v(value) {}
+    Float8(float value): v(_mm256_set1_ps(value)) {}
+
+    static Float8 Load(const float* p) { return _mm256_loadu_ps(p); }
+    void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 Min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+inline Float8 Max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+inline Float8 Sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+inline Float8 Abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+
+// a where a != 0, otherwise b
+inline Float8 NonZeroOr(Float8 a, Float8 b) {
+    return _mm256_blendv_ps(a.v, b.v, _mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_EQ_OQ));
+}
+
+// bit i set when lane i of a is less than that of b, clear for NaN
+inline uint32_t LessMask(Float8 a, Float8 b) {
+    return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)));
+}
+
+// Cephes style log2 for x > 0: split off the exponent, then a polynomial in
+// the mantissa scaled to [sqrt(0.5), sqrt(2)).
+inline Float8 Log2(Float8 x) {
+    __m256i bits = _mm256_castps_si256(x.v);
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                   _mm256_set1_epi32(0x3f800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+
+    Float8 f = Float8(m) - 1.0f;
+    Float8 p = 7.0376836292e-2f;
+    p = p * f - 1.1514610310e-1f;
+    p = p * f + 1.1676998740e-1f;
+    p = p * f - 1.2420140846e-1f;
+    p = p * f + 1.4249322787e-1f;
+    p = p * f - 1.6668057665e-1f;
+    p = p * f + 2.0000714765e-1f;
+    p = p * f - 2.4999993993e-1f;
+    p = p * f + 3.3333331174e-1f;
+    Float8 f2 = f * f;
+    Float8 ln = f + f2 * (f * p - 0.5f);
+    return Float8(e) + ln * 1.44269504089f;
+}
+
+// 2^x, 0 for x < -126 where the result would be denormal and slow down every
+// lane using it.
+inline Float8 Exp2(Float8 x) {
+    __m256 underflow = _mm256_cmp_ps(x.v, _mm256_set1_ps(-126.0f), _CMP_LT_OQ);
+    x = Min(Max(x, -126.0f), 127.0f);
+    __m256 n = _mm256_round_ps(x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    Float8 f = x - Float8(n);
+    Float8 p = 1.535336188319500e-4f;
+    p = p * f + 1.339887440266574e-3f;
+    p = p * f + 9.618437357674640e-3f;
+    p = p * f + 5.550332471162809e-2f;
+    p = p * f + 2.402264791363012e-1f;
+    p = p * f + 6.931472028550421e-1f;
+    p = p * f + 1.0f;
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    Float8 result = p * Float8(_mm256_castsi256_ps(scale));
+    return _mm256_andnot_ps(underflow, result.v);
+}
+
+// x^y for x >= 0, 0^y is 0
+inline Float8 Pow(Float8 x, Float8 y) {
+    __m256 zero = _mm256_cmp_ps(x.v, _mm256_setzero_ps(), _CMP_LE_OQ);
+    Float8 result = Exp2(y * Log2(x));
+    return _mm256_andnot_ps(zero, result.v);
+}
+
+#else
+
+struct Float8 {
+    float v[SimdWidth];
+
+    Float8() = default;
+    Float8(float value) {
+        for (float& lane : v) {
+            lane = value;
+        }
+    }
+
+    static Float8 Load(const float* p) {
+        Float8 result;
+        for (int i = 0; i < SimdWidth; i++) {
+            result.v[i] = p[i];
+        }
+        return result;
+    }
+    void Store(float* p) const {
+        for (int i = 0; i < SimdWidth; i++) {
+            p[i] = v[i];
+        }
+    }
+};
+
+template <typename Op>
+inline Float8 PerLane(Float8 a, Float8 b, Op op) {
+    Float8 result;
+    for (int i = 0; i < SimdWidth; i++) {
+        result.v[i] = op(a.v[i], b.v[i]);
+    }
+    return result;
+}
+
+inline Float8 operator+(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x + y; }); }
+inline Float8 operator-(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x - y; }); }
+inline Float8 operator*(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x * y; }); }
+inline Float8 operator/(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x / y; }); }
+inline Float8 Min(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline Float8 Max(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline Float8 Sqrt(Float8 a) { return PerLane(a, a, [](float x, float) { return std::sqrt(x); }); }
+inline Float8 Abs(Float8 a) { return PerLane(a, a, [](float x, float) { return std::abs(x); }); }
+inline Float8 NonZeroOr(Float8 a, Float8 b) { return PerLane(a, b, [](float x, float y) { return x != 0 ? x : y; }); }
+inline uint32_t LessMask(Float8 a, Float8 b) {
+    uint32_t mask = 0;
+    for (int i = 0; i < SimdWidth; i++) {
+        mask |= uint32_t(a.v[i] < b.v[i]) << i;
+    }
+    return mask;
+}
+inline Float8 Pow(Float8 x, Float8 y) {
+    return PerLane(x, y, [](float a, float b) { return a <= 0 ? 0.0f : std::pow(a, b); });
+}
+inline Float8 Log2(Float8 x) { return PerLane(x, x, [](float a, float) { return std::log2(a); }); }
+
+#endif
+
+inline Float8& operator+=(Float8& a, Float8 b) { return a = a + b; }
+inline Float8& operator*=(Float8& a, Float8 b) { return a = a * b; }
+inline Float8 Clamp(Float8 value, Float8 min, Float8 max) { return Min(Max(value, min), max); }
+
+// SoA forms of Vec2, Vec3 and Vec4, one lane per pixel.
+struct Vec2x8 {
+    Float8 x, y;
+};
+
+struct Vec3x8 {
+    Float8 x, y, z;
+};
+
+struct Vec4x8 {
+    Float8 x, y, z, w;
+};
+
+inline Vec3x8 Splat(const Vec3& v) { return Vec3x8{v.x, v.y, v.z}; }
+inline Vec4x8 Splat(const Vec4& v) { return Vec4x8{v.x, v.y, v.z, v.w}; }
+
+inline Vec3x8 operator+(const Vec3x8& a, const Vec3x8& b) { return Vec3x8{a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3x8 operator-(const Vec3x8& a, const Vec3x8& b) { return Vec3x8{a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3x8 operator*(const Vec3x8& a, Float8 s) { return Vec3x8{a.x * s, a.y * s, a.z * s}; }
+inline Vec3x8 operator/(const Vec3x8& a, Float8 s) { return Vec3x8{a.x / s, a.y / s, a.z / s}; }
+
+inline Float8 Dot(const Vec3x8& a, const Vec3x8& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float8 Len2(const Vec3x8& v) { return Dot(v, v); }
+inline Vec3x8 Normalize(const Vec3x8& v) {
+    Float8 len = Sqrt(Len2(v));
+    return Vec3x8{v.x / len, v.y / len, v.z / len};
+}
+
+inline Vec4x8 operator+(const Vec4x8& a, const Vec4x8& b) { return Vec4x8{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+inline Vec4x8 operator-(const Vec4x8& a, const Vec4x8& b) { return Vec4x8{a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+inline Vec4x8 operator*(const Vec4x8& a, const Vec4x8& b) { return Vec4x8{a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+inline Vec4x8 operator*(const Vec4x8& a, Float8 s) { return Vec4x8{a.x * s, a.y * s, a.z * s, a.w * s}; }
+inline Vec4x8 operator*(Float8 s, const Vec4x8& a) { return a * s; }
+inline Vec4x8& operator+=(Vec4x8& a, const Vec4x8& b) { return a = a + b; }
+inline Vec4x8& operator*=(Vec4x8& a, const Vec4x8& b) { return a = a * b; }
+
+#endif //ENGINE_HOU_CLION_H_SIMD_H
@@ -0,0 +1,290 @@
+//
+// Shaders and mesh setup of the spot scene, shared by the viewer and the benchmark.
+//
+
+#ifndef ENGINE_HOU_CLION_H_SPOT_H
+#define ENGINE_HOU_CLION_H_SPOT_H
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include "renderer.h"
+#include "h_bvh.h"
+#include "h_light.h"
+#include "h_obj.h"
+#include "h_texture.h"
+
+struct SpotVaryings {
+    Vec2 texcoord;
+    Vec3 color;
+    Vec3 normal;
+    Vec4 worldPosition;
+};
+
+struct SpotVaryings8 {
+    Vec2x8 texcoord;
+    Vec3x8 color;
+    Vec3x8 normal;
+    Vec4x8 worldPosition;
+};
+
+// Indices of one loaded mesh in the buffers of BuildMeshBuffers.
+struct MeshRange {
+    size_t first;
+    size_t count;
+};
+
+// Appends the loaded meshes to one vertex and index buffer, merging vertices
+// with identical attributes so that triangles share them. ranges, if given,
+// gets the indices of each mesh.
+inline void BuildMeshBuffers(const std::vector<Mesh>& meshes, VertexBuffer<MeshVertex>& vertices, IndexBuffer& indices,
+                             std::vector<MeshRange>* ranges = nullptr) {
+    std::vector<MeshVertex> unique;
+    std::vector<uint32_t> index;
+    std::unordered_map<std::string, uint32_t> lookup;
+
+    if (ranges) {
+        ranges->clear();
+    }
+    for (const auto& mesh : meshes) {
+        if (ranges) {
+            ranges->push_back(MeshRange{index.size(), mesh.Vertices.size()});
+        }
+        for (const auto& v : mesh.Vertices) {
+            MeshVertex vertex{};
+            vertex.position = Vec4{v.Position.X, v.Position.Y, v.Position.Z, 1.0f};
+            vertex.normal = Vec3{v.Normal.X, v.Normal.Y, v.Normal.Z};
+            vertex.texcoord = Vec2{v.TextureCoordinate.X, v.TextureCoordinate.Y};
+            vertex.color = Vec3{0.0f, 0.0f, 0.0f};
+
+            std::string key(reinterpret_cast<const char*>(&v), sizeof(v));
+            auto it = lookup.find(key);
+            if (it == lookup.end()) {
+                it = lookup.emplace(key, uint32_t(unique.size())).first;
+                unique.push_back(vertex);
+            }
+            index.push_back(it->second);
+        }
+    }
+
+    vertices = VertexBuffer<MeshVertex>(std::move(unique));
+    indices = IndexBuffer(std::move(index));
+}
+
+// BVH over the model space bounds of the meshes, in the order of meshes.
+inline void BuildMeshBvh(const std::vector<Mesh>& meshes, Bvh& bvh) {
+    std::vector<Bvh::Object> objects;
+    objects.reserve(meshes.size());
+    for (const auto& mesh : meshes) {
+        objects.push_back(Bvh::Object{mesh.Bounds, mesh.Sphere});
+    }
+    bvh.Build(std::move(objects));
+}
+
+// Draws the meshes whose bounds are in the camera's frustum, in the order of
+// ranges, and returns how many were drawn. The frustum is moved into model
+// space, so the BVH holds when the model matrix changes. Visible meshes whose
+// indices follow each other go out as one draw.
+template <typename VS, typename FS, typename T>
+size_t DrawVisible(Renderer& renderer, const Camera& camera, const Bvh& bvh, const std::vector<MeshRange>& ranges,
+                   const VS& vs, const FS& fs, const VertexBuffer<T>& vertices, const IndexBuffer& indices) {
+    Vec4 planes[6];
+    TransformPlanes(camera.frustumPlanes, camera.GetModel(), planes);
+
+    std::vector<uint32_t> visible;
+    bvh.Cull(planes, [&](uint32_t mesh) { visible.push_back(mesh); });
+    std::sort(visible.begin(), visible.end());
+
+    MeshRange run{0, 0};
+    for (uint32_t mesh : visible) {
+        const MeshRange& range = ranges[mesh];
+        if (run.count > 0 && range.first == run.first + run.count) {
+            run.count += range.count;
+            continue;
+        }
+        if (run.count > 0) {
+            renderer.Draw(vs, fs, vertices, indices, run.count, run.first);
+        }
+        run = range;
+    }
+    if (run.count > 0) {
+        renderer.Draw(vs, fs, vertices, indices, run.count, run.first);
+    }
+    return visible.size();
+}
+
+struct SpotVertexShader {
+    using Varyings = SpotVaryings;
+
+    const VertexBuffer<MeshVertex>* vertices = nullptr;
+    std::shared_ptr<const Uniforms> uniforms;
+
+    Vec4 operator()(int index, SpotVaryings& output) const {
+        const MeshVertex& vertex = (*vertices)[index];
+
+        output.texcoord = vertex.texcoord;
+        output.normal = Vec<3>(uniforms->normal * Vec4{vertex.normal.x, vertex.normal.y, vertex.normal.z, 0.0f });
+        output.worldPosition = uniforms->model * vertex.position;
+        output.color = vertex.color;
+        return uniforms->viewProjection * output.worldPosition;
+    }
+};
+
+struct SpotFragmentShader {
+    using Varyings = SpotVaryings;
+    using Varyings8 = SpotVaryings8;
+
+    // Lit by the lights of renderer->SetLights. Forward shading tests every light
+    // against its radius per pixel, or per 8 pixels in the wide form; the tile
+    // light lists are only built by the deferred lighting pass, which has the
+    // positions of a tile's surfaces before it lights them.
+    Renderer* renderer = nullptr;
+    std::shared_ptr<const Uniforms> uniforms;
+    const Texture* texture = nullptr;
+    Sampler sampler;
+
+    // Only mip mapped filters use the derivatives, for the texture LOD.
+    bool NeedsDerivatives() const {
+        return renderer->EnableTexture() && sampler.filter != TextureFilter::Nearest;
+    }
+
+    // The forms without derivatives sample the top mip level.
+    Vec4 operator()(SpotVaryings& input) const {
+        return Shade(input, nullptr);
+    }
+
+    Vec4 operator()(SpotVaryings& input, const QuadDerivatives<SpotVaryings>& derivatives) const {
+        return Shade(input, &derivatives);
+    }
+
+    // Surface form for deferred shading, the renderer lights it later.
+    void operator()(SpotVaryings& input, GBufferTexel& output) const {
+        Surface(input, nullptr, output);
+    }
+
+    void operator()(SpotVaryings& input, const QuadDerivatives<SpotVaryings>& derivatives,
+                    GBufferTexel& output) const {
+        Surface(input, &derivatives, output);
+    }
+
+    // The same shading for the 8 pixels of a SoA batch, texture lookups are only
+    // made for the lanes set in laneMask.
+    Vec4x8 operator()(SpotVaryings8& input, uint32_t laneMask) const {
+        return Shade(input, nullptr, laneMask);
+    }
+
+    Vec4x8 operator()(SpotVaryings8& input, const QuadDerivatives<SpotVaryings8>& derivatives,
+                      uint32_t laneMask) const {
+        return Shade(input, &derivatives, laneMask);
+    }
+
+private:
+    Color4 Albedo(const SpotVaryings& input, const QuadDerivatives<SpotVaryings>* derivatives) const {
+        float lod = derivatives && sampler.filter != TextureFilter::Nearest
+                    ? texture->Lod(derivatives->ddx.texcoord, derivatives->ddy.texcoord) : 0.0f;
+        return texture->Sample(Vec2{input.texcoord.x, 1.0f - input.texcoord.y}, lod, sampler);
+    }
+
+    Vec4 Shade(SpotVaryings& input, const QuadDerivatives<SpotVaryings>* derivatives) const {
+
+        Vec4 final(renderer->GetambiColor());
+
+        if(renderer->EnableLight()){
+
+            Vec4 worldPos = input.worldPosition;
+            Vec4 ks = Vec4{0.7937, 0.7937, 0.7937, 1.0f};
+
+            Vec3 N = Normalize(input.normal);
+            Vec3 Pos = Vec3{worldPos.x, worldPos.y, worldPos.z} / worldPos.w;
+
+            for (const PointLight& light : renderer->GetLights()) {
+                if (!InRange(light, Pos)) {
+                    continue;
+                }
+                final += PointLightShading(light, Pos, N, uniforms->eye, ks, 750.0f,
+                                           renderer->GetdiffColor(), renderer->GetspecColor());
+            }
+            if(!renderer->IsHdr()){
+                if(final.x >1.0f) final.x = 1.0f;
+                if(final.y >1.0f) final.y = 1.0f;
+                if(final.z >1.0f) final.z = 1.0f;
+            }
+            final.w = 1.0f;
+
+        }
+
+        if(renderer->EnableTexture()){
+            final *= Albedo(input, derivatives);
+        }
+
+        // HDR targets get linear color, the renderer encodes it when presenting
+        if(renderer->IsHdr()){
+            return final;
+        }
+
+        float gamma = 0.454f;
+        final.x = std::pow(final.x,gamma);
+        final.y = std::pow(final.y,gamma);
+        final.z = std::pow(final.z,gamma);
+        return final;
+    }
+
+    void Surface(SpotVaryings& input, const QuadDerivatives<SpotVaryings>* derivatives, GBufferTexel& output) const {
+        Vec4 worldPos = input.worldPosition;
+        output.normal = Normalize(input.normal);
+        output.position = Vec3{worldPos.x, worldPos.y, worldPos.z} / worldPos.w;
+        output.albedo = Color4{1.0f, 1.0f, 1.0f, 1.0f};
+        if(renderer->EnableTexture()){
+            output.albedo = Albedo(input, derivatives);
+        }
+        output.specular = 0.7937f;
+        output.shininess = 750.0f;
+    }
+
+    Vec4x8 Shade(SpotVaryings8& input, const QuadDerivatives<SpotVaryings8>* derivatives, uint32_t laneMask) const {
+
+        Vec4x8 final = Splat(renderer->GetambiColor());
+
+        if(renderer->EnableLight()){
+
+            Vec4x8 worldPos = input.worldPosition;
+            Vec4 ks = Vec4{0.7937, 0.7937, 0.7937, 1.0f};
+
+            Vec3x8 N = Normalize(input.normal);
+            Vec3x8 Pos = Vec3x8{worldPos.x, worldPos.y, worldPos.z} / worldPos.w;
+
+            for (const PointLight& light : renderer->GetLights()) {
+                if (!(InRange(light, Pos) & laneMask)) {
+                    continue;
+                }
+                final += PointLightShading(light, Pos, N, uniforms->eye, ks, 750.0f,
+                                           renderer->GetdiffColor(), renderer->GetspecColor());
+            }
+            if(!renderer->IsHdr()){
+                final.x = Min(final.x, 1.0f);
+                final.y = Min(final.y, 1.0f);
+                final.z = Min(final.z, 1.0f);
+            }
+            final.w = 1.0f;
+        }
+
+        if(renderer->EnableTexture()){
+            Float8 lod = derivatives && sampler.filter != TextureFilter::Nearest
+                         ? texture->Lod(derivatives->ddx.texcoord, derivatives->ddy.texcoord) : Float8(0.0f);
+            Vec2x8 uv{input.texcoord.x, Float8(1.0f) - input.texcoord.y};
+            final *= texture->Sample(uv, lod, sampler, laneMask);
+        }
+
+        if(renderer->IsHdr()){
+            return final;
+        }
+
+        Float8 gamma = 0.454f;
+        final.x = Pow(final.x, gamma);
+        final.y = Pow(final.y, gamma);
+        final.z = Pow(final.z, gamma);
+        return final;
+    }
+};
+
+#endif //ENGINE_HOU_CLION_H_SPOT_H
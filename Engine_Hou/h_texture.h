@@ -0,0 +1,509 @@
+//
+// Mipmapped textures stored as RGBA8 or as BC1/BC3 blocks that are decoded when
+// sampled, and the samplers that filter them, 1 or 8 coordinates at a time.
+//
+
+#ifndef ENGINE_HOU_CLION_H_TEXTURE_H
+#define ENGINE_HOU_CLION_H_TEXTURE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "h_blockcompress.h"
+#include "h_framebuffer.h"
+#include "h_simd.h"
+
+enum class TextureFilter {
+    Nearest,    // the full size image, unfiltered
+    Bilinear,   // the nearest mip level, filtered
+    Trilinear,  // blend of the two nearest mip levels, both filtered
+};
+
+enum class TextureWrap {
+    Clamp,      // coordinates clamped to [0, 1], edge texels repeated
+    Repeat,     // the texture tiled
+};
+
+// How a texture is read, shared by any number of textures.
+struct Sampler {
+    TextureFilter filter = TextureFilter::Trilinear;
+    TextureWrap wrapU = TextureWrap::Clamp;
+    TextureWrap wrapV = TextureWrap::Clamp;
+};
+
+enum class TextureFormat {
+    RGBA8,
+    BC1,    // 8 bytes a 4x4 block, 1 bit alpha
+    BC3,    // 16 bytes a 4x4 block, BC1 color and interpolated alpha
+};
+
+class Texture {
+public:
+    Texture() = default;
+
+    // Copies the image and builds its mip chain down to 1x1, every texel of a
+    // level being the average of the 2x2 texels under it. Compressed formats
+    // encode each level after the chain is built.
+    explicit Texture(const FrameBuffer& image, TextureFormat format = TextureFormat::RGBA8): id_(NewId()) {
+        Allocate(image.Width(), image.Height(), 0, TextureFormat::RGBA8);
+        for (int y = 0; y < image.Height(); y++) {
+            std::copy_n(image.Row(y), image.Width(), &texels_[size_t(y) * image.Width()]);
+        }
+
+        for (int i = 1; i < Levels(); i++) {
+            const Level& source = levels_[i - 1];
+            const Level& level = levels_[i];
+            for (int y = 0; y < level.height; y++) {
+                for (int x = 0; x < level.width; x++) {
+                    int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1),
+                            y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+                    Uint32 texels[4] = {Texel(i - 1, x0, y0), Texel(i - 1, x1, y0),
+                                        Texel(i - 1, x0, y1), Texel(i - 1, x1, y1)};
+                    Uint32 even = 0x00020002, odd = 0x00020002;
+                    for (Uint32 texel : texels) {
+                        even += texel & 0x00ff00ff;
+                        odd += (texel >> 8) & 0x00ff00ff;
+                    }
+                    texels_[level.offset + size_t(y) * level.width + x] =
+                            ((even >> 2) & 0x00ff00ff) | (((odd >> 2) & 0x00ff00ff) << 8);
+                }
+            }
+        }
+
+        if (format != TextureFormat::RGBA8) {
+            Compress(format);
+        }
+    }
+
+    // Reads a DDS file of RGBA8, DXT1 (BC1) or DXT5 (BC3) data with its mip
+    // levels, returns false and leaves the texture as it was if the file can't
+    // be read or holds another format.
+    bool LoadDds(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        Uint8 header[DdsHeaderBytes];
+        if (!file.read(reinterpret_cast<char*>(header), DdsHeaderBytes) ||
+            std::string(reinterpret_cast<char*>(header), 4) != "DDS " || DdsField(header, 0) != 124) {
+            return false;
+        }
+
+        TextureFormat format;
+        uint32_t formatFlags = DdsField(header, 19), fourCC = DdsField(header, 20);
+        if ((formatFlags & DdsFourCC) && fourCC == DdsFourCCOf("DXT1")) {
+            format = TextureFormat::BC1;
+        } else if ((formatFlags & DdsFourCC) && fourCC == DdsFourCCOf("DXT5")) {
+            format = TextureFormat::BC3;
+        } else if ((formatFlags & DdsRGB) && DdsField(header, 21) == 32 && DdsField(header, 22) == 0x000000ff &&
+                   DdsField(header, 23) == 0x0000ff00 && DdsField(header, 24) == 0x00ff0000) {
+            format = TextureFormat::RGBA8;
+        } else {
+            return false;
+        }
+
+        int width = int(DdsField(header, 3)), height = int(DdsField(header, 2));
+        int count = (DdsField(header, 1) & DdsMipMapCount) ? std::max(int(DdsField(header, 6)), 1) : 1;
+        if (width <= 0 || height <= 0) {
+            return false;
+        }
+
+        // the levels follow each other in the file as they do in memory
+        Texture loaded;
+        loaded.Allocate(width, height, count, format);
+        if (format == TextureFormat::RGBA8) {
+            file.read(reinterpret_cast<char*>(loaded.texels_.data()), std::streamsize(loaded.texels_.size() * 4));
+        } else {
+            file.read(reinterpret_cast<char*>(loaded.blocks_.data()), std::streamsize(loaded.blocks_.size()));
+        }
+        if (!file) {
+            return false;
+        }
+
+        *this = std::move(loaded);
+        id_ = NewId();
+        return true;
+    }
+
+    bool SaveDds(const std::string& path) const {
+        if (levels_.empty()) {
+            return false;
+        }
+        bool compressed = format_ != TextureFormat::RGBA8;
+        Uint8 header[DdsHeaderBytes] = {'D', 'D', 'S', ' '};
+        SetDdsField(header, 0, 124);
+        SetDdsField(header, 1, 0x1 | 0x2 | 0x4 | 0x1000 | DdsMipMapCount | (compressed ? 0x80000 : 0x8));
+        SetDdsField(header, 2, uint32_t(Height()));
+        SetDdsField(header, 3, uint32_t(Width()));
+        SetDdsField(header, 4, uint32_t(compressed ? LevelBytes(0) : size_t(Width()) * 4));
+        SetDdsField(header, 6, uint32_t(Levels()));
+        SetDdsField(header, 18, 32);
+        if (compressed) {
+            SetDdsField(header, 19, DdsFourCC);
+            SetDdsField(header, 20, DdsFourCCOf(format_ == TextureFormat::BC1 ? "DXT1" : "DXT5"));
+        } else {
+            SetDdsField(header, 19, DdsRGB | 0x1);
+            SetDdsField(header, 21, 32);
+            SetDdsField(header, 22, 0x000000ff);
+            SetDdsField(header, 23, 0x0000ff00);
+            SetDdsField(header, 24, 0x00ff0000);
+            SetDdsField(header, 25, 0xff000000);
+        }
+        SetDdsField(header, 26, 0x1000 | (Levels() > 1 ? 0x400008 : 0));
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(header), DdsHeaderBytes);
+        if (compressed) {
+            file.write(reinterpret_cast<const char*>(blocks_.data()), std::streamsize(blocks_.size()));
+        } else {
+            file.write(reinterpret_cast<const char*>(texels_.data()), std::streamsize(texels_.size() * 4));
+        }
+        return bool(file);
+    }
+
+    int Levels() const { return int(levels_.size()); }
+    int Width(int level = 0) const { return levels_[level].width; }
+    int Height(int level = 0) const { return levels_[level].height; }
+    TextureFormat Format() const { return format_; }
+
+    // bytes of texel data over all levels
+    size_t Bytes() const { return texels_.size() * sizeof(Uint32) + blocks_.size(); }
+
+    // Mip level of a footprint given by the screen space derivatives of the
+    // texture coordinates, log2 of its longer side in texels of level 0. NaN
+    // derivatives give the lowest lod rather than a NaN one.
+    float Lod(const Vec2& ddx, const Vec2& ddy) const {
+        float w = float(levels_[0].width), h = float(levels_[0].height);
+        float x2 = ddx.x * ddx.x * w * w + ddx.y * ddx.y * h * h,
+                y2 = ddy.x * ddy.x * w * w + ddy.y * ddy.y * h * h;
+        float longer = x2 > y2 ? x2 : y2;
+        return 0.5f * std::log2(longer > 1e-20f ? longer : 1e-20f);
+    }
+
+    // Max takes its second operand when either is NaN
+    Float8 Lod(const Vec2x8& ddx, const Vec2x8& ddy) const {
+        float w2 = float(levels_[0].width) * levels_[0].width, h2 = float(levels_[0].height) * levels_[0].height;
+        Float8 x2 = ddx.x * ddx.x * w2 + ddx.y * ddx.y * h2,
+                y2 = ddy.x * ddy.x * w2 + ddy.y * ddy.y * h2;
+        return Log2(Max(Max(x2, y2), 1e-20f)) * 0.5f;
+    }
+
+    Color4 Sample(const Vec2& uv, float lod, const Sampler& sampler) const {
+        Vec2 st{Wrap(uv.x, sampler.wrapU), Wrap(uv.y, sampler.wrapV)};
+        switch (sampler.filter) {
+            case TextureFilter::Nearest:
+                return SampleNearest(st);
+            case TextureFilter::Bilinear:
+                return SampleBilinear(st, lod > 0 ? int(std::min(lod + 0.5f, float(Levels() - 1))) : 0, sampler);
+            default:
+                return SampleTrilinear(st, lod, sampler);
+        }
+    }
+
+    // Sample of the 8 lanes of uv at their own lods, lanes outside laneMask are
+    // 0. RGBA8 textures fetch their texels with AVX2 gathers, compressed ones
+    // decode lane by lane.
+    Vec4x8 Sample(const Vec2x8& uv, Float8 lod, const Sampler& sampler, uint32_t laneMask) const {
+#if defined(ENGINE_HOU_AVX2)
+        if (format_ == TextureFormat::RGBA8) {
+            return GatherSample(uv, lod, sampler, laneMask);
+        }
+#endif
+        alignas(32) float u[SimdWidth], v[SimdWidth], lods[SimdWidth];
+        alignas(32) float r[SimdWidth] = {}, g[SimdWidth] = {}, b[SimdWidth] = {}, a[SimdWidth] = {};
+        uv.x.Store(u);
+        uv.y.Store(v);
+        lod.Store(lods);
+        for (int lane = 0; lane < SimdWidth; lane++) {
+            if (laneMask & (1u << lane)) {
+                Color4 texel = Sample(Vec2{u[lane], v[lane]}, lods[lane], sampler);
+                r[lane] = texel.x;
+                g[lane] = texel.y;
+                b[lane] = texel.z;
+                a[lane] = texel.w;
+            }
+        }
+        return Vec4x8{Float8::Load(r), Float8::Load(g), Float8::Load(b), Float8::Load(a)};
+    }
+
+private:
+    // Where a level starts in texels_, or in blocks_ for compressed textures,
+    // whose levels are rows of blocksWide blocks. Plain ints, so the fields of
+    // 8 levels at once can be gathered.
+    struct Level {
+        int width;
+        int height;
+        int offset;
+        int blocksWide;
+    };
+    static_assert(std::is_standard_layout<Level>::value && sizeof(Level) == 4 * sizeof(int),
+                  "Level is gathered as 4 ints");
+
+    static constexpr int DdsHeaderBytes = 128;
+    static constexpr uint32_t DdsMipMapCount = 0x20000, DdsFourCC = 0x4, DdsRGB = 0x40;
+
+    // little endian field i of the DDS header, after the magic
+    static uint32_t DdsField(const Uint8* header, int i) {
+        const Uint8* p = header + 4 + 4 * i;
+        return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+    }
+
+    static void SetDdsField(Uint8* header, int i, uint32_t value) {
+        for (int b = 0; b < 4; b++) {
+            header[4 + 4 * i + b] = Uint8(value >> 8 * b);
+        }
+    }
+
+    static uint32_t DdsFourCCOf(const char* code) {
+        return uint32_t(Uint8(code[0])) | uint32_t(Uint8(code[1])) << 8 | uint32_t(Uint8(code[2])) << 16 |
+               uint32_t(Uint8(code[3])) << 24;
+    }
+
+    static int BlockBytes(TextureFormat format) {
+        return format == TextureFormat::BC1 ? BC1BlockBytes : BC3BlockBytes;
+    }
+
+    // Identifies the texture in the decoded block caches, a texture whose data
+    // changes takes a new one.
+    static uint32_t NewId() {
+        static std::atomic<uint32_t> next{1};
+        return next++;
+    }
+
+    // Lays out count levels from width x height down, or the whole chain to
+    // 1x1 for count 0, and sizes the storage of the format for them.
+    void Allocate(int width, int height, int count, TextureFormat format) {
+        levels_.clear();
+        size_t size = 0;
+        while (true) {
+            Level level{width, height, int(size), (width + 3) / 4};
+            levels_.push_back(level);
+            size += format == TextureFormat::RGBA8 ? size_t(width) * height
+                                                   : size_t(level.blocksWide) * ((height + 3) / 4) * BlockBytes(format);
+            if ((width == 1 && height == 1) || Levels() == count) {
+                break;
+            }
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+
+        format_ = format;
+        texels_.assign(format == TextureFormat::RGBA8 ? size : 0, 0);
+        blocks_.assign(format == TextureFormat::RGBA8 ? 0 : size, 0);
+    }
+
+    size_t LevelBytes(int level) const {
+        size_t end = level + 1 < Levels() ? size_t(levels_[level + 1].offset) : std::max(texels_.size(), blocks_.size());
+        return (end - levels_[level].offset) * (format_ == TextureFormat::RGBA8 ? sizeof(Uint32) : 1);
+    }
+
+    void Compress(TextureFormat format) {
+        std::vector<Level> source = levels_;
+        std::vector<Uint32> texels = std::move(texels_);
+        Allocate(source[0].width, source[0].height, int(source.size()), format);
+
+        int blockBytes = BlockBytes(format);
+        for (int i = 0; i < Levels(); i++) {
+            const Level& from = source[i];
+            const Level& level = levels_[i];
+            for (int by = 0; by < (level.height + 3) / 4; by++) {
+                for (int bx = 0; bx < level.blocksWide; bx++) {
+                    // blocks past the edge of small levels repeat the last texels
+                    Uint32 block[BlockTexels];
+                    for (int t = 0; t < BlockTexels; t++) {
+                        int x = std::min(bx * 4 + t % 4, from.width - 1), y = std::min(by * 4 + t / 4, from.height - 1);
+                        block[t] = texels[from.offset + size_t(y) * from.width + x];
+                    }
+                    Uint8* out = &blocks_[level.offset + (size_t(by) * level.blocksWide + bx) * blockBytes];
+                    if (format == TextureFormat::BC1) {
+                        EncodeBC1Block(block, out);
+                    } else {
+                        EncodeBC3Block(block, out);
+                    }
+                }
+            }
+        }
+    }
+
+    Uint32 Texel(int level, int x, int y) const {
+        if (format_ == TextureFormat::RGBA8) {
+            const Level& l = levels_[level];
+            return texels_[l.offset + size_t(y) * l.width + x];
+        }
+        return DecodedBlock(level, x >> 2, y >> 2)[(y & 3) * 4 + (x & 3)];
+    }
+
+    // The decoded texels of a block, through a small cache per thread. Its
+    // slots are picked by the block's position within an 8x8 window of blocks
+    // and by the parity of the level, so the 4 texels of a bilinear tap and the
+    // 2 levels of a trilinear one never evict each other.
+    const Uint32* DecodedBlock(int level, int bx, int by) const {
+        struct Entry {
+            uint64_t key;
+            Uint32 texels[BlockTexels];
+        };
+        thread_local Entry cache[128] = {};
+
+        const Level& l = levels_[level];
+        size_t index = size_t(by) * l.blocksWide + bx;
+        uint64_t key = uint64_t(id_) << 37 | uint64_t(level) << 32 | index;
+        Entry& entry = cache[(level & 1) << 6 | (by & 7) << 3 | (bx & 7)];
+        if (entry.key != key) {
+            entry.key = key;
+            if (format_ == TextureFormat::BC1) {
+                DecodeBC1Block(&blocks_[l.offset + index * BC1BlockBytes], entry.texels);
+            } else {
+                DecodeBC3Block(&blocks_[l.offset + index * BC3BlockBytes], entry.texels);
+            }
+        }
+        return entry.texels;
+    }
+
+    // texel of level 0 under st
+    Color4 SampleNearest(const Vec2& st) const {
+        const Level& level = levels_[0];
+        int x = std::min(int(st.x * level.width), level.width - 1),
+                y = std::min(int(st.y * level.height), level.height - 1);
+        return UnpackRGBA8(Texel(0, x, y));
+    }
+
+    // the 4 texels of a level around st, weighted by distance
+    Color4 SampleBilinear(const Vec2& st, int level, const Sampler& sampler) const {
+        const Level& l = levels_[level];
+        float x = st.x * l.width - 0.5f, y = st.y * l.height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float tx = x - fx, ty = y - fy;
+        int x0, x1, y0, y1;
+        Neighbours(int(fx), l.width, sampler.wrapU, x0, x1);
+        Neighbours(int(fy), l.height, sampler.wrapV, y0, y1);
+
+        Color4 top = Lerp(UnpackRGBA8(Texel(level, x0, y0)), UnpackRGBA8(Texel(level, x1, y0)), tx),
+                bottom = Lerp(UnpackRGBA8(Texel(level, x0, y1)), UnpackRGBA8(Texel(level, x1, y1)), tx);
+        return Lerp(top, bottom, ty);
+    }
+
+    // a NaN lod reads level 0
+    Color4 SampleTrilinear(const Vec2& st, float lod, const Sampler& sampler) const {
+        lod = lod > 0 ? std::min(lod, float(Levels() - 1)) : 0.0f;
+        int level = int(lod);
+        float t = lod - float(level);
+        if (t == 0.0f) {
+            return SampleBilinear(st, level, sampler);
+        }
+        return Lerp(SampleBilinear(st, level, sampler), SampleBilinear(st, level + 1, sampler), t);
+    }
+
+    // coordinate in [0, 1], for Repeat in [0, 1) but for rounding
+    static float Wrap(float value, TextureWrap wrap) {
+        if (wrap == TextureWrap::Clamp) {
+            return std::min(std::max(value, 0.0f), 1.0f);
+        }
+        return value - std::floor(value);
+    }
+
+    // the texel i and the one after it of a row of size, i being -1 to size - 1
+    static void Neighbours(int i, int size, TextureWrap wrap, int& i0, int& i1) {
+        if (wrap == TextureWrap::Clamp) {
+            i0 = std::max(i, 0);
+            i1 = std::min(i + 1, size - 1);
+        } else {
+            i0 = i < 0 ? i + size : i;
+            i1 = i + 1 == size ? 0 : i + 1;
+        }
+    }
+
+    static Color4 Lerp(const Color4& a, const Color4& b, float t) { return a + (b - a) * t; }
+
+#if defined(ENGINE_HOU_AVX2)
+    static Float8 Wrap(Float8 value, TextureWrap wrap) {
+        if (wrap == TextureWrap::Clamp) {
+            return Min(Max(value, 0.0f), 1.0f);
+        }
+        return value - Float8(_mm256_floor_ps(value.v));
+    }
+
+    static void Neighbours(__m256i i, __m256i size, TextureWrap wrap, __m256i& i0, __m256i& i1) {
+        __m256i next = _mm256_add_epi32(i, _mm256_set1_epi32(1));
+        if (wrap == TextureWrap::Clamp) {
+            i0 = _mm256_max_epi32(i, _mm256_setzero_si256());
+            i1 = _mm256_min_epi32(next, _mm256_sub_epi32(size, _mm256_set1_epi32(1)));
+        } else {
+            i0 = _mm256_add_epi32(i, _mm256_and_si256(size, _mm256_cmpgt_epi32(_mm256_setzero_si256(), i)));
+            i1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(next, size), next);
+        }
+    }
+
+    static Vec4x8 Unpack(__m256i texels) {
+        auto channel = [texels](int shift) {
+            __m256i value = _mm256_and_si256(_mm256_srli_epi32(texels, shift), _mm256_set1_epi32(0xff));
+            return Float8(_mm256_cvtepi32_ps(value)) / 255.0f;
+        };
+        return Vec4x8{channel(RedShift), channel(GreenShift), channel(BlueShift), channel(AlphaShift)};
+    }
+
+    static Vec4x8 Lerp(const Vec4x8& a, const Vec4x8& b, Float8 t) { return a + (b - a) * t; }
+
+    Vec4x8 Gather(__m256i index, __m256i mask) const {
+        return Unpack(_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(texels_.data()),
+                                                  index, mask, 4));
+    }
+
+    Vec4x8 GatherSample(const Vec2x8& uv, Float8 lod, const Sampler& sampler, uint32_t laneMask) const {
+        __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(int(laneMask)), lanes), lanes);
+        Vec2x8 st{Wrap(uv.x, sampler.wrapU), Wrap(uv.y, sampler.wrapV)};
+
+        if (sampler.filter == TextureFilter::Nearest) {
+            const Level& level = levels_[0];
+            __m256i x = _mm256_min_epi32(_mm256_cvttps_epi32((st.x * float(level.width)).v),
+                                         _mm256_set1_epi32(level.width - 1));
+            __m256i y = _mm256_min_epi32(_mm256_cvttps_epi32((st.y * float(level.height)).v),
+                                         _mm256_set1_epi32(level.height - 1));
+            return Gather(_mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(level.width)), x), mask);
+        }
+
+        // lods are clamped before they are converted, Max(NaN, 0) is 0
+        __m256i last = _mm256_set1_epi32(Levels() - 1);
+        if (sampler.filter == TextureFilter::Bilinear) {
+            __m256i level = _mm256_cvttps_epi32(Min(Max(lod + 0.5f, 0.0f), float(Levels() - 1)).v);
+            return GatherBilinear(st, level, sampler, mask);
+        }
+
+        lod = Min(Max(lod, 0.0f), float(Levels() - 1));
+        __m256i level = _mm256_cvttps_epi32(lod.v);
+        Float8 t = lod - Float8(_mm256_cvtepi32_ps(level));
+        __m256i next = _mm256_min_epi32(_mm256_add_epi32(level, _mm256_set1_epi32(1)), last);
+        return Lerp(GatherBilinear(st, level, sampler, mask), GatherBilinear(st, next, sampler, mask), t);
+    }
+
+    Vec4x8 GatherBilinear(const Vec2x8& st, __m256i level, const Sampler& sampler, __m256i mask) const {
+        const int* fields = reinterpret_cast<const int*>(levels_.data());
+        __m256i field = _mm256_slli_epi32(level, 2);
+        __m256i width = _mm256_i32gather_epi32(fields, field, 4),
+                height = _mm256_i32gather_epi32(fields + 1, field, 4),
+                offset = _mm256_i32gather_epi32(fields + 2, field, 4);
+
+        Float8 x = st.x * Float8(_mm256_cvtepi32_ps(width)) - 0.5f, y = st.y * Float8(_mm256_cvtepi32_ps(height)) - 0.5f;
+        Float8 fx = _mm256_floor_ps(x.v), fy = _mm256_floor_ps(y.v);
+        Float8 tx = x - fx, ty = y - fy;
+        __m256i x0, x1, y0, y1;
+        Neighbours(_mm256_cvttps_epi32(fx.v), width, sampler.wrapU, x0, x1);
+        Neighbours(_mm256_cvttps_epi32(fy.v), height, sampler.wrapV, y0, y1);
+
+        __m256i row0 = _mm256_add_epi32(offset, _mm256_mullo_epi32(y0, width)),
+                row1 = _mm256_add_epi32(offset, _mm256_mullo_epi32(y1, width));
+        Vec4x8 top = Lerp(Gather(_mm256_add_epi32(row0, x0), mask), Gather(_mm256_add_epi32(row0, x1), mask), tx),
+                bottom = Lerp(Gather(_mm256_add_epi32(row1, x0), mask), Gather(_mm256_add_epi32(row1, x1), mask), tx);
+        return Lerp(top, bottom, ty);
+    }
+#endif
+
+    std::vector<Level> levels_;
+    std::vector<Uint32> texels_;
+    std::vector<Uint8> blocks_;
+    TextureFormat format_ = TextureFormat::RGBA8;
+    uint32_t id_ = 0;
+};
+
+#endif //ENGINE_HOU_CLION_H_TEXTURE_H
@@ -0,0 +1,111 @@
+//
+// Fixed-size worker pool used by the binned rasterizer.
+//
+
+#ifndef ENGINE_HOU_CLION_H_THREADPOOL_H
+#define ENGINE_HOU_CLION_H_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool final {
+public:
+    explicit ThreadPool(int threadCount) {
+        for (int i = 1; i < threadCount; i++) {
+            workers.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // worker threads plus the calling thread
+    int Size() const { return int(workers.size()) + 1; }
+
+    // Runs job(i) for every i in [0, count) and returns once all of them finished.
+    // The calling thread takes jobs as well.
+    void ParallelFor(int count, const std::function<void(int)>& job) {
+        if (workers.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) {
+                job(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentJob = &job;
+            jobCount = count;
+            nextIndex = 0;
+            busyWorkers = int(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        RunJobs(job, count);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        currentJob = nullptr;
+    }
+
+private:
+    void RunJobs(const std::function<void(int)>& job, int count) {
+        for (int i = nextIndex.fetch_add(1); i < count; i = nextIndex.fetch_add(1)) {
+            job(i);
+        }
+    }
+
+    void WorkerLoop() {
+        size_t seen = 0;
+        while (true) {
+            const std::function<void(int)>* job;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) {
+                    return;
+                }
+                seen = generation;
+                job = currentJob;
+                count = jobCount;
+            }
+
+            RunJobs(*job, count);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* currentJob = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex{0};
+    int busyWorkers = 0;
+    size_t generation = 0;
+    bool quit = false;
+};
+
+#endif //ENGINE_HOU_CLION_H_THREADPOOL_H
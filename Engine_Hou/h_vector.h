@@ -5,7 +5,9 @@
 #ifndef ENGINE_HOU_CLION_H_VECTOR_H
 #define ENGINE_HOU_CLION_H_VECTOR_H
 
+#include <cstddef>
 #include <ostream>
+#include <type_traits>
 
 template <size_t Dim> class Vector {
 public:
@@ -16,32 +18,23 @@ public:
 
     Vector() = default;
 
-    Vector(float value) {
+    constexpr Vector(float value) : data{} {
         for (size_t i = 0; i < Dim; i++) {
             data[i] = value;
         }
     }
 
-    Vector(const std::initializer_list<float> &l) { Assign(l); }
+    // the elements not given are 0
+    template <typename... T, typename = std::enable_if_t<(sizeof...(T) >= 2 && sizeof...(T) <= Dim)>>
+    constexpr Vector(T... values) : data{float(values)...} {}
 
-    float &operator[](size_t idx) { return data[idx]; }
-    float operator[](size_t idx) const { return data[idx]; }
-
-    void Assign(const std::initializer_list<float> &l) {
-        size_t max = std::min(Dim, l.size());
-        size_t i = 0;
-        for (i = 0; i < max; i++) {
-            data[i] = *(l.begin() + i);
-        }
-        for (; i < Dim; i++) {
-            data[i] = 0;
-        }
-    }
+    constexpr float &operator[](size_t idx) { return data[idx]; }
+    constexpr float operator[](size_t idx) const { return data[idx]; }
 };
 
-template <size_t Dim> const Vector<Dim> Vector<Dim>::One(1);
+template <size_t Dim> constexpr Vector<Dim> Vector<Dim>::One(1);
 
-template <size_t Dim> const Vector<Dim> Vector<Dim>::Zero(0);
+template <size_t Dim> constexpr Vector<Dim> Vector<Dim>::Zero(0);
 
 template <> class Vector<2> {
 public:
@@ -56,25 +49,15 @@ public:
 
     Vector() = default;
 
-    Vector(const std::initializer_list<float> &l) { Assign(l); }
-
-    float &operator[](size_t idx) { return data[idx]; }
-    float operator[](size_t idx) const { return data[idx]; }
+    constexpr explicit Vector(float x) : data{x} {}
+    constexpr Vector(float x, float y) : data{x, y} {}
 
-    void Assign(const std::initializer_list<float> &l) {
-        size_t max = std::min<size_t>(2, l.size());
-        size_t i = 0;
-        for (i = 0; i < max; i++) {
-            data[i] = *(l.begin() + i);
-        }
-        for (; i < 2; i++) {
-            data[i] = 0;
-        }
-    }
+    constexpr float &operator[](size_t idx) { return data[idx]; }
+    constexpr float operator[](size_t idx) const { return data[idx]; }
 };
 
-const Vector<2> Vector<2>::One{1, 1};
-const Vector<2> Vector<2>::Zero{0, 0};
+constexpr Vector<2> Vector<2>::One{1, 1};
+constexpr Vector<2> Vector<2>::Zero{0, 0};
 
 inline float Cross(const Vector<2> &v1, const Vector<2> &v2) {
     return v1.x * v2.y - v1.y * v2.x;
@@ -95,25 +78,15 @@ public:
 
     Vector() = default;
 
-    Vector(const std::initializer_list<float> &l) { Assign(l); }
-
-    float &operator[](size_t idx) { return data[idx]; }
-    float operator[](size_t idx) const { return data[idx]; }
+    constexpr explicit Vector(float x) : data{x} {}
+    constexpr Vector(float x, float y, float z = 0) : data{x, y, z} {}
 
-    void Assign(const std::initializer_list<float> &l) {
-        size_t max = std::min<size_t>(3, l.size());
-        size_t i = 0;
-        for (; i < max; i++) {
-            data[i] = *(l.begin() + i);
-        }
-        for (; i < 3; i++) {
-            data[i] = 0;
-        }
-    }
+    constexpr float &operator[](size_t idx) { return data[idx]; }
+    constexpr float operator[](size_t idx) const { return data[idx]; }
 };
 
-const Vector<3> Vector<3>::One{1, 1, 1};
-const Vector<3> Vector<3>::Zero{0, 0, 0};
+constexpr Vector<3> Vector<3>::One{1, 1, 1};
+constexpr Vector<3> Vector<3>::Zero{0, 0, 0};
 
 inline Vector<3> Cross(const Vector<3> &v1, const Vector<3> &v2) {
     return Vector<3>{v1.y * v2.z - v1.z * v2.y,
@@ -121,7 +94,8 @@ inline Vector<3> Cross(const Vector<3> &v1, const Vector<3> &v2) {
                      v1.x * v2.y - v1.y * v2.x};
 }
 
-template <> class Vector<4> {
+// 16 byte aligned, so the SSE kernels of h_matrix.h load and store it whole.
+template <> class alignas(16) Vector<4> {
 public:
     static const Vector One;
     static const Vector Zero;
@@ -138,25 +112,15 @@ public:
 
     Vector() = default;
 
-    Vector(const std::initializer_list<float> &l) { Assign(l); }
-
-    float &operator[](size_t idx) { return data[idx]; }
-    float operator[](size_t idx) const { return data[idx]; }
+    constexpr explicit Vector(float x) : data{x} {}
+    constexpr Vector(float x, float y, float z = 0, float w = 0) : data{x, y, z, w} {}
 
-    void Assign(const std::initializer_list<float> &l) {
-        size_t max = std::min<size_t>(4, l.size());
-        size_t i = 0;
-        for (; i < max; i++) {
-            data[i] = *(l.begin() + i);
-        }
-        for (; i < 4; i++) {
-            data[i] = 0;
-        }
-    }
+    constexpr float &operator[](size_t idx) { return data[idx]; }
+    constexpr float operator[](size_t idx) const { return data[idx]; }
 };
 
-const Vector<4> Vector<4>::One{1, 1, 1, 1};
-const Vector<4> Vector<4>::Zero{0, 0, 0, 0};
+constexpr Vector<4> Vector<4>::One{1, 1, 1, 1};
+constexpr Vector<4> Vector<4>::Zero{0, 0, 0, 0};
 
 template <size_t Dim>
 Vector<Dim> operator*(const Vector<Dim> &self, float value) {
@@ -344,4 +308,11 @@ using Vec4 = Vector<4>;
 using Color4 = Vec4;
 using Color3 = Vec3;
 
+// Plain arrays of floats, so varyings and vertex buffers made of them can be
+// copied and interpolated as such.
+static_assert(std::is_trivially_copyable<Vec2>::value && sizeof(Vec2) == 2 * sizeof(float));
+static_assert(std::is_trivially_copyable<Vec3>::value && sizeof(Vec3) == 3 * sizeof(float));
+static_assert(std::is_trivially_copyable<Vec4>::value && sizeof(Vec4) == 4 * sizeof(float) && alignof(Vec4) == 16);
+static_assert(std::is_standard_layout<Vec4>::value && offsetof(Vec4, data) == 0);
+
 #endif //ENGINE_HOU_CLION_H_VECTOR_H
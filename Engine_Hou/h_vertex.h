@@ -3,26 +3,53 @@
 //
 
 #include <array>
+#include <cstdint>
+#include <vector>
 #include <algorithm>
 #include "h_shader.h"
 
 #ifndef ENGINE_HOU_CLION_H_VERTEX_H
 #define ENGINE_HOU_CLION_H_VERTEX_H
 
-struct Vertex {
-    ShaderContext context;
+template <typename V>
+struct VertexT {
+    V varyings;
     float rw;
     Vec4 pos4;
     Vec3 pos3;
     Vec2 pos2;
 };
 
-struct TriangleH{
-    Vertex v1;
-    Vertex v2;
-    Vertex v3;
+using Vertex = VertexT<ShaderContext>;
+
+constexpr int SubPixelBits = 4;
+constexpr int SubPixelScale = 1 << SubPixelBits;
+
+// Edge functions E(x, y) = a * x + b * y + c in sub-pixel fixed point, one per
+// vertex (the edge opposite to it), oriented so that inside means E >= 0.
+// c already carries the top-left fill rule bias, E + bias is the unbiased value.
+struct TriangleEdges {
+    int64_t a[3];
+    int64_t b[3];
+    int64_t c[3];
+    int64_t bias[3];
+    int64_t area;
+    int minX, minY, maxX, maxY;
 };
 
+template <typename V>
+struct TriangleT {
+    VertexT<V> v1;
+    VertexT<V> v2;
+    VertexT<V> v3;
+    TriangleEdges edges;
+    float nearestZ;
+    uint32_t drawID;
+    uint32_t triangleID;
+};
+
+using TriangleH = TriangleT<ShaderContext>;
+
 class Triangle{
 
 public:
@@ -95,4 +122,45 @@ public:
     };*/
 };
 
+// Attributes of one mesh vertex, the element type of the mesh VertexBuffer.
+struct MeshVertex {
+    Vec4 position;
+    Vec3 normal;
+    Vec2 texcoord;
+    Vec3 color;
+};
+
+template <typename T>
+class VertexBuffer {
+public:
+    VertexBuffer() = default;
+    explicit VertexBuffer(std::vector<T> vertices): data_(std::move(vertices)) {}
+
+    void Push(const T& vertex) { data_.push_back(vertex); }
+    void Reserve(size_t count) { data_.reserve(count); }
+
+    const T& operator[](size_t index) const { return data_[index]; }
+    const T* Data() const { return data_.data(); }
+    size_t Size() const { return data_.size(); }
+
+private:
+    std::vector<T> data_;
+};
+
+class IndexBuffer {
+public:
+    IndexBuffer() = default;
+    explicit IndexBuffer(std::vector<uint32_t> indices): data_(std::move(indices)) {}
+
+    void Push(uint32_t index) { data_.push_back(index); }
+    void Reserve(size_t count) { data_.reserve(count); }
+
+    uint32_t operator[](size_t index) const { return data_[index]; }
+    const uint32_t* Data() const { return data_.data(); }
+    size_t Size() const { return data_.size(); }
+
+private:
+    std::vector<uint32_t> data_;
+};
+
 #endif //ENGINE_HOU_CLION_H_VERTEX_H
@@ -14,12 +14,46 @@
 #include <iostream>
 #include <memory>
 #include <unordered_map>
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
+#include "h_camera.h"
+#include "h_clip.h"
 #include "h_drawline.h"
 #include "h_framebuffer.h"
+#include "h_light.h"
+#include "h_threadpool.h"
 
 constexpr float floatInf = FLT_MAX;
+// slack for the interpolated depth overshooting the vertex depths by rounding
+constexpr float HiZEpsilon = 1e-5f;
+// side of the sub-tiles the light lists of a tile are refined to
+constexpr int LightCullSize = 16;
+
+struct RenderStats {
+    uint64_t trianglesHiZRejected = 0;
+    uint64_t tilesHiZRejected = 0;
+    uint64_t blocksHiZRejected = 0;
+    uint64_t vertexCacheHits = 0;
+    uint64_t vertexCacheMisses = 0;
+    uint64_t litPixels = 0;
+    uint64_t lightsEvaluated = 0;
+    // time spent in Clear, and 8x8 blocks filled with the clear value when the
+    // rasterizer first touched them afterwards
+    double clearMs = 0;
+    uint64_t blocksCleared = 0;
+
+    double VertexCacheHitRate() const {
+        uint64_t lookups = vertexCacheHits + vertexCacheMisses;
+        return lookups ? double(vertexCacheHits) / double(lookups) : 0.0;
+    }
+
+    // lights shaded per pixel of the deferred lighting pass
+    double LightsPerPixel() const {
+        return litPixels ? double(lightsEvaluated) / double(litPixels) : 0.0;
+    }
+};
 
 enum UniformVec2 {
     Texcoord = 0,
@@ -55,66 +89,26 @@ public:
     Renderer(int w, int h)
             : drawColor{0, 0, 0, 0} {
         framebuffer.reset(new FrameBuffer(w, h));
+        colorBuffer = new TiledBuffer<Uint32>(w, h);
         depthBuffer = new Buffer2D(w, h);
+        hiZBuffer = new HiZBuffer(w, h);
+        tilesX = (w + TileSize - 1) / TileSize;
+        tilesY = (h + TileSize - 1) / TileSize;
+        UpdateClipPlanes();
     }
 
     ~Renderer() {
+        delete gBuffer;
+        delete hdrBuffer;
+        delete multisampleBuffer;
+        delete visibilityBuffer;
+        delete hiZBuffer;
         delete depthBuffer;
+        delete colorBuffer;
     }
 
 public:
 
-    Vec4 planes[6];
-    struct pos_buf_id
-    {
-        int pos_id = 0;
-    };
-
-    struct ind_buf_id
-    {
-        int ind_id = 0;
-    };
-
-    struct col_buf_id
-    {
-        int col_id = 0;
-    };
-
-    int normal_id = -1;
-    int next_id = 0;
-    int get_next_id() { return next_id++; }
-
-    std::map<int, std::vector<Vec3>> pos_buf;
-    std::map<int, std::vector<Vec3>> ind_buf;
-    std::map<int, std::vector<Vec3>> col_buf;
-    std::map<int, std::vector<Vec3>> nor_buf;
-
-    pos_buf_id load_positions(const std::vector<Vec3> &positions)
-    {
-        auto id = get_next_id();
-        pos_buf.emplace(id, positions);
-
-        return {id};
-    }
-
-    ind_buf_id load_indices(const std::vector<Vec3> &indices)
-    {
-        auto id = get_next_id();
-        ind_buf.emplace(id, indices);
-
-        return {id};
-    }
-
-    col_buf_id load_normals(const std::vector<Vec3>& normals)
-    {
-        auto id = get_next_id();
-        nor_buf.emplace(id, normals);
-
-        normal_id = id;
-
-        return {id};
-    }
-
     void SetDrawColor(const Color4 &c) { drawColor = c; }
     void SetambiColor(const Color4 &c) { ambiColor = c; }
     void SetdiffColor(const Color4 &c) { diffColor = c; }
@@ -128,15 +122,59 @@ public:
 
     void SetFaceCull(FaceCull fc) { faceCull = fc; }
 
+    // Color and depth are cleared lazily, a block takes the clear values when it
+    // is first drawn to and blocks never drawn to are presented as BG directly.
     void Clear() {
-        framebuffer->Clear(BG);
-        depthBuffer->Fill(0);
+        auto begin = std::chrono::steady_clock::now();
+        ResetBatches();
+        // Flush presents the cleared target to the whole framebuffer
+        if (enableMultisample) {
+            multisampleBuffer->Clear(PackRGBA8(BG), 0);
+        } else if (enableHdr) {
+            hdrBuffer->Clear(DecodeHdr(BG, exposure));
+        } else {
+            colorBuffer->Clear(PackRGBA8(BG));
+        }
+        colorDirty = true;
+        depthBuffer->Clear(0);
+        hiZBuffer->Fill(0);
+        if (visibilityBuffer) {
+            visibilityBuffer->Clear();
+        }
+        if (gBuffer) {
+            gBuffer->Clear();
+        }
+        trianglesHiZRejected = 0;
+        tilesHiZRejected = 0;
+        blocksHiZRejected = 0;
+        vertexCacheHits = 0;
+        vertexCacheMisses = 0;
+        litPixels = 0;
+        lightsEvaluated = 0;
+        blocksCleared = 0;
+        clearMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    // counters since the last Clear
+    RenderStats GetStats() const {
+        RenderStats stats;
+        stats.trianglesHiZRejected = trianglesHiZRejected;
+        stats.tilesHiZRejected = tilesHiZRejected;
+        stats.blocksHiZRejected = blocksHiZRejected;
+        stats.vertexCacheHits = vertexCacheHits;
+        stats.vertexCacheMisses = vertexCacheMisses;
+        stats.litPixels = litPixels;
+        stats.lightsEvaluated = lightsEvaluated;
+        stats.clearMs = clearMs;
+        stats.blocksCleared = blocksCleared;
+        return stats;
     }
 
     void DrawPixel(int x, int y, Color4 drawcolor) {
         if (IsPointInRect(Vec2{float(x), float(y)},
                           Rect{Vec2{0, 0}, framebuffer->Size()})) {
-            framebuffer->PutPixel(x, y, drawcolor);
+            WritePixel(x, y, drawcolor, (1u << MsaaSamples) - 1);
+            colorDirty = true;
         }
     }
 
@@ -149,6 +187,14 @@ public:
         viewport.Set(2, 2, 0.5);
         viewport.Set(3, 2, 1);
         viewport.Set(3, 3, 1);
+        UpdateClipPlanes();
+    }
+
+    // Sign of the near plane distance, as passed to Persp. It decides on which
+    // side of w = 0 the visible half of clip space lies.
+    void SetNearPlane(float near) {
+        clipSign = near < 0 ? -1.0f : 1.0f;
+        UpdateClipPlanes();
     }
 
     const Mat4x4& GetViewport() const {
@@ -158,11 +204,173 @@ public:
 
 
     void SetVertexShader(VertexShader shader) { vertexShader = shader; }
-    void SetFragmentShader(FragmentShader shader) { fragmentShader = shader; }
+    void SetFragmentShader(FragmentShader shader) {
+        Flush();
+        fragmentShader = shader;
+    }
 
 
     void EnableFaceCull(bool e) { enableFaceCull = e; }
-    void EnableDepthTest(bool e) { enableDepthTest = e; }
+    void EnableDepthTest(bool e) {
+        Flush();
+        enableDepthTest = e;
+    }
+
+    // Binned mode only records triangles in the draw calls, Flush rasterizes the
+    // screen tiles on the worker pool. Every tile replays its triangles in
+    // submission order, so the result matches the serial path exactly.
+    void EnableBinning(bool e) {
+        Flush();
+        enableBinning = e;
+    }
+    bool IsBinning() const { return enableBinning; }
+
+    void SetThreadCount(int count) {
+        Flush();
+        threadPool.reset(new ThreadPool(std::max(count, 1)));
+    }
+    int GetThreadCount() const { return threadPool ? threadPool->Size() : 1; }
+
+    // Visibility buffer mode only stores depth and (draw, triangle) per pixel while
+    // rasterizing, Flush then runs the fragment shader once per covered pixel.
+    void EnableVisibilityBuffer(bool e) {
+        Flush();
+        enableVisibilityBuffer = e;
+        if (e && !visibilityBuffer) {
+            visibilityBuffer = new VisibilityBuffer(framebuffer->Width(), framebuffer->Height());
+        }
+        if (e) {
+            enableMultisample = false;
+        }
+    }
+    bool IsVisibilityBuffer() const { return enableVisibilityBuffer; }
+
+    // 4x MSAA: coverage and depth are tested per sample, the fragment shader runs
+    // once per pixel and triangle and its color goes to the samples that passed.
+    // Flush averages the samples into the framebuffer. Turns the visibility buffer,
+    // deferred shading and HDR off.
+    void EnableMultisample(bool e) {
+        Flush();
+        enableMultisample = e;
+        if (e) {
+            if (!multisampleBuffer) {
+                multisampleBuffer = new MultisampleBuffer(framebuffer->Width(), framebuffer->Height());
+            }
+            multisampleBuffer->Clear(PackRGBA8(BG), 0);
+            depthBuffer->Clear(0);
+            hiZBuffer->Fill(0);
+            enableVisibilityBuffer = false;
+            enableDeferred = false;
+            enableHdr = false;
+        }
+        colorDirty = false;
+    }
+    bool IsMultisample() const { return enableMultisample; }
+
+    // HDR mode: shaders write linear, unclamped color (shaders check IsHdr) to a
+    // float target, and presenting applies the exposure, the ACES curve and the
+    // sRGB encoding once per pixel. Turns MSAA off.
+    void EnableHdr(bool e) {
+        Flush();
+        enableHdr = e;
+        if (e) {
+            if (!hdrBuffer) {
+                hdrBuffer = new TiledBuffer<Color4>(framebuffer->Width(), framebuffer->Height());
+            }
+            hdrBuffer->Clear(DecodeHdr(BG, exposure));
+            EnableMultisample(false);
+        }
+        colorDirty = false;
+    }
+    bool IsHdr() const { return enableHdr; }
+
+    // scale applied to the linear color before tonemapping
+    void SetExposure(float e) {
+        Flush();
+        exposure = e;
+    }
+    float GetExposure() const { return exposure; }
+
+    // Deferred mode: fragment shaders with a surface form (HasSurfaceShader) only
+    // fill the G-buffer, Flush then lights each covered pixel once with the lights
+    // of SetLights. Lights are culled per tile by their radius, so a pixel only
+    // evaluates the ones that reach it. Other shaders still shade forward. Turns
+    // MSAA off.
+    void EnableDeferred(bool e) {
+        Flush();
+        enableDeferred = e;
+        if (e && !gBuffer) {
+            gBuffer = new GBuffer(framebuffer->Width(), framebuffer->Height());
+        }
+        if (e) {
+            EnableMultisample(false);
+        }
+    }
+    bool IsDeferred() const { return enableDeferred; }
+
+    void SetLights(const std::vector<PointLight>& l) {
+        Flush();
+        lights = l;
+    }
+    const std::vector<PointLight>& GetLights() const { return lights; }
+
+    // Uniform block of camera. It is only rebuilt when the camera changed since
+    // the last call, otherwise the same block is handed out again.
+    std::shared_ptr<const Uniforms> GetUniforms(const Camera& camera) {
+        if (!uniforms || uniformsVersion != camera.Version()) {
+            auto block = std::make_shared<Uniforms>();
+            block->model = camera.GetModel();
+            block->view = camera.GetView();
+            block->projection = camera.GetProjection();
+            block->viewProjection = block->projection * block->view;
+            block->modelViewProjection = block->viewProjection * block->model;
+            block->normal = camera.GetNormalMatrix();
+            block->eye = camera.lookfrom;
+            uniforms = std::move(block);
+            uniformsVersion = camera.Version();
+        }
+        return uniforms;
+    }
+
+    // Shaders with a wide form (HasWideShader) are run on rows of 8 pixels at a
+    // time outside of the visibility buffer mode.
+    void EnableSimdFragments(bool e) {
+        Flush();
+        enableSimdFragments = e;
+    }
+    bool IsSimdFragments() const { return enableSimdFragments; }
+
+    // Post-transform cache of DrawIndexed. 0 keeps every transformed vertex of a
+    // draw, so each one is shaded once, otherwise a FIFO of that many entries.
+    void SetVertexCacheSize(int size) {
+        vertexCacheSize = size > 0 ? std::max(size, 3) : 0;
+    }
+    int GetVertexCacheSize() const { return vertexCacheSize; }
+
+    void Flush() {
+        if (!batches.empty()) {
+            if (enableDeferred) {
+                lightingEye = LightingEye();
+            }
+            if (enableBinning) {
+                FlushBins();
+            } else if (enableVisibilityBuffer || enableDeferred) {
+                Pool().ParallelFor(tilesX * tilesY, [this](int tile) {
+                    ResolveTile(tile % tilesX, tile / tilesX);
+                });
+            }
+            ResetBatches();
+        }
+
+        // binned flushes present each tile right after shading it
+        if (colorDirty) {
+            Pool().ParallelFor(tilesX * tilesY, [this](int tile) {
+                PresentTile(tile % tilesX, tile / tilesX);
+            });
+            colorDirty = false;
+        }
+    }
+
     bool OnlyDrawLine() { return onlyDrawLine; }
     bool EnableLight() { return enableLight; }
     bool EnableTexture() { return enableTexture; }
@@ -173,31 +381,213 @@ public:
         if (!vertexShader) {
             return false;
         }
+        Vec4 pos[3];
+        for (int i = 0; i < 3; i++) {
+            ShaderContext context;
+            pos[i] = vertexShader(i, context);
+        }
+        return DrawTriangleLines(pos);
+    }
+
+    // Runs the pipeline over count indices of indexBuffer, three per triangle.
+    // The vertex shader gets the vertex index into vertexBuffer.
+    template <typename T>
+    bool DrawIndexed(const VertexBuffer<T>& vertexBuffer, const IndexBuffer& indexBuffer, size_t count) {
+        if (!vertexShader) {
+            return false;
+        }
+        return DrawIndexed<ShaderContext>(vertexShader, fragmentShader, vertexBuffer, indexBuffer, count);
+    }
+
+    // Same with the varyings of the program, a plain struct of floats, instead of
+    // the ShaderContext maps of SetVertexShader and SetFragmentShader.
+    template <typename V, typename T>
+    bool DrawIndexed(const ShaderProgram<V>& program, const VertexBuffer<T>& vertexBuffer,
+                     const IndexBuffer& indexBuffer, size_t count) {
+        if (!program.vertexShader) {
+            return false;
+        }
+        return DrawIndexed<V>(program.vertexShader, program.fragmentShader, vertexBuffer, indexBuffer, count);
+    }
+
+    // Indexed draw with the shaders as template parameters, so both are inlined
+    // into the vertex and raster loops. VS::Varyings names the varying struct,
+    // VS is called as Vec4(int index, Varyings&) and FS as Vec4(Varyings&). The
+    // count indices start at first, so a mesh of a shared buffer is drawn alone.
+    template <typename VS, typename FS, typename T>
+    bool Draw(const VS& vs, const FS& fs, const VertexBuffer<T>& vertexBuffer,
+              const IndexBuffer& indexBuffer, size_t count, size_t first = 0) {
+        return DrawIndexed<typename VS::Varyings>(vs, fs, vertexBuffer, indexBuffer, count, first);
+    }
+
+    bool DrawPrimitive() {
+        if (!vertexShader) {
+            return false;
+        }
+        auto& batch = BeginDraw<ShaderContext>(fragmentShader);
+
+        Vertex vertices[3];
         for (int i = 0; i < 3; i++) {
             Vertex& vertex = vertices[i];
-            vertex.context.Clear();
-            vertex.pos4 = vertexShader(i, vertices[i].context);
-            vertex.rw = 1.0 / (vertex.pos4.w == 0 ? 1e-5 : vertex.pos4.w);
+            vertex.pos4 = vertexShader(i, vertex.varyings);
         }
 
+        return ClipTriangle(batch, vertices[0], vertices[1], vertices[2]);
+    }
+
+private:
+
+    // Triangles of one draw call with the fragment shader that shades them. The
+    // binned and visibility buffer modes keep them until Flush, the varying type
+    // is hidden behind the virtual calls made per tile and per resolved pixel.
+    struct DrawBatch {
+        virtual ~DrawBatch() = default;
+
+        virtual size_t TriangleCount() const = 0;
+        // returns the number of triangles rejected by the Hi-Z tile test
+        virtual uint64_t RasterTile(Renderer& renderer, int tile, int minX, int minY, int maxX, int maxY) = 0;
+        virtual void ResolvePixel(Renderer& renderer, uint32_t triangleID, int i, int j) = 0;
+
+        void Reset(int tileCount) {
+            triangleTiles.clear();
+            tileBins.resize(tileCount);
+            for (auto& bin : tileBins) {
+                bin.clear();
+            }
+        }
+
+        void Bin(uint32_t index, int tx0, int ty0, int tx1, int ty1, int tilesX) {
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    tileBins[ty * tilesX + tx].push_back(index);
+                }
+            }
+            triangleTiles.push_back(uint32_t((tx1 - tx0 + 1) * (ty1 - ty0 + 1)));
+        }
+
+        std::vector<uint32_t> triangleTiles;
+        std::vector<std::vector<uint32_t>> tileBins;
+        // of the fragment shader, if it has one (HasUniforms)
+        std::shared_ptr<const Uniforms> uniforms;
+        // per triangle, tiles whose Hi-Z test rejected it during FlushBins
+        std::unique_ptr<std::atomic<uint32_t>[]> rejectedTiles;
+    };
+
+    template <typename V, typename FS>
+    struct DrawBatchT final : DrawBatch {
+        struct CacheEntry {
+            uint32_t index = 0xffffffffu;
+            VertexT<V> vertex;
+        };
+
+        explicit DrawBatchT(const FS& shader): fragmentShader(shader) {}
+
+        size_t TriangleCount() const override { return triangles.size(); }
+
+        uint64_t RasterTile(Renderer& renderer, int tile, int minX, int minY, int maxX, int maxY) override {
+            uint64_t rejected = 0;
+            for (uint32_t index : tileBins[tile]) {
+                const TriangleT<V>& triangle = triangles[index];
+                if (renderer.enableDepthTest && renderer.OccludedByHiZ(triangle.nearestZ, tile % renderer.tilesX, tile / renderer.tilesX)) {
+                    rejectedTiles[index].fetch_add(1, std::memory_order_relaxed);
+                    rejected++;
+                    continue;
+                }
+                renderer.RasterizeTriangle(triangle, fragmentShader,
+                                           std::max(triangle.edges.minX, minX),
+                                           std::max(triangle.edges.minY, minY),
+                                           std::min(triangle.edges.maxX, maxX),
+                                           std::min(triangle.edges.maxY, maxY));
+            }
+            return rejected;
+        }
+
+        void ResolvePixel(Renderer& renderer, uint32_t triangleID, int i, int j) override {
+            const TriangleT<V>& triangle = triangles[triangleID];
+            Vec3 barycentric;
+            renderer.InterpolateDepth(triangle,
+                                      EvaluateEdge(triangle.edges, 0, i, j),
+                                      EvaluateEdge(triangle.edges, 1, i, j),
+                                      EvaluateEdge(triangle.edges, 2, i, j),
+                                      barycentric);
+            renderer.ShadeFragment(triangle, fragmentShader, i, j, barycentric);
+        }
+
+        FS fragmentShader;
+        std::vector<TriangleT<V>> triangles;
+
+        // post-transform vertex cache of DrawIndexed
+        std::vector<VertexT<V>> transformed;
+        std::vector<uint32_t> transformedStamp;
+        uint32_t transformedDraw = 0;
+        uint32_t transformedFirst = 0;     // vertex index of transformed[0]
+        std::vector<CacheEntry> fifo;
+        int fifoHead = 0;
+    };
+
+    template <typename V, typename VS, typename FS, typename T>
+    bool DrawIndexed(const VS& shader, const FS& fragment, const VertexBuffer<T>& vertexBuffer,
+                     const IndexBuffer& indexBuffer, size_t count, size_t first = 0) {
+        first = std::min(first, indexBuffer.Size());
+        count = std::min(count, indexBuffer.Size() - first) / 3 * 3;
+        auto& batch = BeginDraw<V>(fragment);
+        if (vertexCacheSize == 0) {
+            // the cache covers the vertices the indices reach, not the whole buffer
+            uint32_t minIndex = 0xffffffffu, maxIndex = 0;
+            for (size_t i = first; i < first + count; i++) {
+                uint32_t index = indexBuffer[i];
+                if (index < vertexBuffer.Size()) {
+                    minIndex = std::min(minIndex, index);
+                    maxIndex = std::max(maxIndex, index);
+                }
+            }
+            BeginVertexCache(batch, minIndex, minIndex <= maxIndex ? maxIndex - minIndex + 1 : 0);
+        } else {
+            BeginVertexCache(batch, 0, 0);
+        }
+
+        bool drawn = false;
+        for (size_t i = 0; i < count; i += 3) {
+            const uint32_t* index = indexBuffer.Data() + first + i;
+            if (index[0] >= vertexBuffer.Size() || index[1] >= vertexBuffer.Size() || index[2] >= vertexBuffer.Size()) {
+                continue;
+            }
+
+            const VertexT<V>* triangle[3];
+            int claimed[3] = {-1, -1, -1};
+            for (int k = 0; k < 3; k++) {
+                triangle[k] = &TransformVertex(batch, shader, index[k], claimed, k);
+            }
+
+            if (onlyDrawLine) {
+                Vec4 pos[3] = {triangle[0]->pos4, triangle[1]->pos4, triangle[2]->pos4};
+                drawn |= DrawTriangleLines(pos);
+            } else {
+                drawn |= ClipTriangle(batch, *triangle[0], *triangle[1], *triangle[2]);
+            }
+        }
+        return drawn;
+    }
+
+    bool DrawTriangleLines(Vec4 (&pos)[3]) {
         for (int i = 0; i < 3; i++) {
-            float absw = std::abs(vertices[i].pos4.w);
-            if (vertices[i].pos4.x < -absw || vertices[i].pos4.x > absw ||
-                vertices[i].pos4.y < -absw || vertices[i].pos4.y > absw) {
+            float absw = std::abs(pos[i].w);
+            if (pos[i].x < -absw || pos[i].x > absw ||
+                pos[i].y < -absw || pos[i].y > absw) {
                 return false;
             }
         }
-        for (auto& vertex : vertices) {
 
-            vertex.pos4 *= vertex.rw;
-            vertex.pos3 = Vec<3>(viewport * vertex.pos4);
-            vertex.pos2.x = int(vertex.pos3.x + 0.5f);
-            vertex.pos2.y = int(vertex.pos3.y + 0.5f);
-            vertex.context.varyingVec2[ScreenPosition] = Vec2{vertex.pos2.x, vertex.pos2.y};
+        Vec2 pos2[3];
+        for (int i = 0; i < 3; i++) {
+            float rw = 1.0 / (pos[i].w == 0 ? 1e-5 : pos[i].w);
+            Vec3 pos3 = Vec<3>(viewport * (pos[i] * rw));
+            pos2[i].x = int(pos3.x + 0.5f);
+            pos2[i].y = int(pos3.y + 0.5f);
         }
 
         for(int i = 0; i < 3; ++i){
-            Line2D::Bresenham bresenham(Vec2{vertices[i].pos2.x, vertices[i].pos2.y}, Vec2{vertices[(i + 1) % 3].pos2.x, vertices[(i + 1) % 3].pos2.y});
+            Line2D::Bresenham bresenham(pos2[i], pos2[(i + 1) % 3]);
             while (!bresenham.IsFinished()) {
                 DrawPixel(bresenham.CurPoint().x, bresenham.CurPoint().y, {1.0, 1.0, 1.0, 1.0});
                 bresenham.Step();
@@ -209,27 +599,55 @@ public:
         return true;
     }
 
-    bool DrawPrimitive() {
-        if (!vertexShader) {
+    // Rejects triangles outside one clip plane, clips the ones crossing the near
+    // plane or leaving the guard band and sets up what remains.
+    template <typename V, typename FS>
+    bool ClipTriangle(DrawBatchT<V, FS>& batch, const VertexT<V>& v0, const VertexT<V>& v1, const VertexT<V>& v2) {
+        uint32_t code0 = ClipOutcode(v0.pos4, clipPlanes),
+                code1 = ClipOutcode(v1.pos4, clipPlanes),
+                code2 = ClipOutcode(v2.pos4, clipPlanes);
+        if (code0 & code1 & code2) {
             return false;
         }
 
-        for (int i = 0; i < 3; i++) {
-            Vertex& vertex = vertices[i];
-
-            vertex.context.Clear();
-            vertex.pos4 = vertexShader(i, vertices[i].context);
+        const uint32_t mustClip = (1u << ClipNear) | (1u << ClipGuardLeft) | (1u << ClipGuardRight) |
+                                  (1u << ClipGuardBottom) | (1u << ClipGuardTop);
+        uint32_t crossed = (code0 | code1 | code2) & mustClip;
+        if (!crossed) {
+            return SetupTriangle(batch, v0, v1, v2);
+        }
 
-            if(!isPointInFrustum(vertex.pos4, planes)){
-                return false;
+        VertexT<V> polygon[MaxClipVertices] = {v0, v1, v2};
+        VertexT<V> clipped[MaxClipVertices];
+        int count = 3;
+        for (int plane = 0; plane < ClipPlaneCount && count >= 3; plane++) {
+            if (crossed & (1u << plane)) {
+                count = ClipPolygon(polygon, count, clipPlanes[plane], clipped);
+                std::copy(clipped, clipped + count, polygon);
             }
+        }
 
+        bool drawn = false;
+        for (int i = 1; i + 1 < count; i++) {
+            drawn |= SetupTriangle(batch, polygon[0], polygon[i], polygon[i + 1]);
+        }
+        return drawn;
+    }
+
+    template <typename V, typename FS>
+    bool SetupTriangle(DrawBatchT<V, FS>& batch, const VertexT<V>& v0, const VertexT<V>& v1, const VertexT<V>& v2) {
+        TriangleT<V> triangle {v0, v1, v2, {}, 0.0f, 0, 0};
+        VertexT<V>* v = &triangle.v1;
+
+        for (int i = 0; i < 3; i++) {
+            VertexT<V>& vertex = v[i];
             vertex.rw = 1.0 / (vertex.pos4.w == 0 ? 1e-5 : vertex.pos4.w);
+            vertex.pos4 *= vertex.rw;
         }
 
         if (enableFaceCull) {
-            float result = Cross(Vec<2>(vertices[1].pos4 - vertices[0].pos4),
-                                Vec<2>(vertices[2].pos4 - vertices[1].pos4));
+            float result = Cross(Vec<2>(v[1].pos4 - v[0].pos4),
+                                 Vec<2>(v[2].pos4 - v[1].pos4));
 
             if (faceCull == CCW && result >= 0) {
                 return false;
@@ -238,105 +656,873 @@ public:
             }
         }
 
-        for (auto& vertex : vertices) {
-
-            vertex.pos4 *= vertex.rw;
+        for (int i = 0; i < 3; i++) {
+            VertexT<V>& vertex = v[i];
             vertex.pos3 = Vec<3>(viewport * vertex.pos4);
             vertex.pos2.x = int(vertex.pos3.x + 0.5f);
             vertex.pos2.y = int(vertex.pos3.y + 0.5f);
+        }
 
+        if (!SetupEdges(triangle, enableMultisample ? MsaaSampleReach : 0)) {
+            return false;
         }
+        colorDirty = true;
+        triangle.nearestZ = std::max({v[0].pos3.z, v[1].pos3.z, v[2].pos3.z});
+        triangle.drawID = uint32_t(batches.size() - 1);
+        triangle.triangleID = uint32_t(batch.triangles.size());
 
+        int minX = std::max(triangle.edges.minX, 0),
+                minY = std::max(triangle.edges.minY, 0),
+                maxX = std::min(triangle.edges.maxX, framebuffer->Width()),
+                maxY = std::min(triangle.edges.maxY, framebuffer->Height());
 
-        if (Cross(vertices[0].pos2 - vertices[1].pos2,
-                  vertices[0].pos2 - vertices[2].pos2) == 0) {
+        if (minX >= maxX || minY >= maxY) {
             return false;
         }
 
+        if (enableBinning) {
+            uint32_t index = triangle.triangleID;
+            batch.triangles.push_back(std::move(triangle));
+            batch.Bin(index, minX / TileSize, minY / TileSize,
+                      (maxX - 1) / TileSize, (maxY - 1) / TileSize, tilesX);
+            return true;
+        }
 
-        TriangleH triangle {vertices[0], vertices[1], vertices[2]};
+        if (enableDepthTest && OccludedByHiZ(triangle.nearestZ, minX, minY, maxX, maxY)) {
+            trianglesHiZRejected++;
+            return false;
+        }
 
-        Rect boundingBox = AABB(triangle);
-        int minX = std::max<int>(boundingBox.pos.x, 0),
-                minY = std::max<int>(boundingBox.pos.y, 0),
-                maxX = std::min<int>(boundingBox.pos.x + boundingBox.size.w, framebuffer->Width()),
-                maxY = std::min<int>(boundingBox.pos.y + boundingBox.size.h, framebuffer->Height());
+        if (enableVisibilityBuffer) {
+            batch.triangles.push_back(std::move(triangle));
+            RasterizeTriangle(batch.triangles.back(), batch.fragmentShader, minX, minY, maxX, maxY);
+            return true;
+        }
 
+        RasterizeTriangle(triangle, batch.fragmentShader, minX, minY, maxX, maxY);
+        return true;
+    }
 
-        for (int i = minX; i < maxX; i++) {
-            for (int j = minY; j < maxY; j++) {
-                Vec2 p{i + 0.5f, j+ 0.5f};
+    void UpdateClipPlanes() {
+        float halfW = std::max(std::abs(viewport.Get(0, 0)), 1.0f),
+                halfH = std::max(std::abs(viewport.Get(1, 1)), 1.0f);
+        BuildClipPlanes(clipSign, 1.0f + GuardBandPixels / halfW, 1.0f + GuardBandPixels / halfH, clipPlanes);
+    }
+
+    // In full mode the cache holds vertexCount vertices from firstVertex on.
+    template <typename V, typename FS>
+    void BeginVertexCache(DrawBatchT<V, FS>& batch, uint32_t firstVertex, size_t vertexCount) {
+        if (vertexCacheSize == 0) {
+            batch.transformedFirst = firstVertex;
+            if (batch.transformedStamp.size() < vertexCount) {
+                batch.transformed.resize(vertexCount);
+                batch.transformedStamp.resize(vertexCount, 0);
+            }
+            if (++batch.transformedDraw == 0) {
+                std::fill(batch.transformedStamp.begin(), batch.transformedStamp.end(), 0);
+                batch.transformedDraw = 1;
+            }
+        } else {
+            batch.fifo.assign(vertexCacheSize, typename DrawBatchT<V, FS>::CacheEntry{});
+            batch.fifoHead = 0;
+        }
+    }
 
-                Vec3 barycentric = Barycentric(triangle, p);
+    // Returns the shaded vertex for index, running the vertex shader on a miss.
+    // claimed holds the FIFO slots of the current triangle, which are not evicted.
+    template <typename V, typename FS, typename VS>
+    const VertexT<V>& TransformVertex(DrawBatchT<V, FS>& batch, const VS& shader,
+                                      uint32_t index, int (&claimed)[3], int corner) {
+        VertexT<V>* vertex;
+        if (vertexCacheSize == 0) {
+            uint32_t slot = index - batch.transformedFirst;
+            vertex = &batch.transformed[slot];
+            if (batch.transformedStamp[slot] == batch.transformedDraw) {
+                vertexCacheHits++;
+                return *vertex;
+            }
+            batch.transformedStamp[slot] = batch.transformedDraw;
+        } else {
+            for (int slot = 0; slot < vertexCacheSize; slot++) {
+                if (batch.fifo[slot].index == index) {
+                    vertexCacheHits++;
+                    claimed[corner] = slot;
+                    return batch.fifo[slot].vertex;
+                }
+            }
+            int slot = batch.fifoHead;
+            while (slot == claimed[0] || slot == claimed[1] || slot == claimed[2]) {
+                slot = (slot + 1) % vertexCacheSize;
+            }
+            batch.fifoHead = (slot + 1) % vertexCacheSize;
+            claimed[corner] = slot;
+            batch.fifo[slot].index = index;
+            vertex = &batch.fifo[slot].vertex;
+        }
 
-                if (!IsPointInTriangle(p, barycentric)) {
+        vertexCacheMisses++;
+        vertex->varyings = V{};
+        vertex->pos4 = shader(int(index), vertex->varyings);
+        return *vertex;
+    }
+
+    // Starts a draw call, batches of a finished frame are reused when their
+    // varying type matches so their storage is kept.
+    template <typename V, typename FS>
+    DrawBatchT<V, FS>& BeginDraw(const FS& shader) {
+        std::unique_ptr<DrawBatch> batch;
+        for (auto it = freeBatches.begin(); it != freeBatches.end(); ++it) {
+            if (dynamic_cast<DrawBatchT<V, FS>*>(it->get())) {
+                batch = std::move(*it);
+                freeBatches.erase(it);
+                break;
+            }
+        }
+        if (!batch) {
+            batch.reset(new DrawBatchT<V, FS>(shader));
+        }
+
+        auto& typed = static_cast<DrawBatchT<V, FS>&>(*batch);
+        typed.Reset(tilesX * tilesY);
+        typed.triangles.clear();
+        typed.fragmentShader = shader;
+        if constexpr (HasUniforms<FS>::value) {
+            typed.uniforms = shader.uniforms;
+        } else {
+            typed.uniforms.reset();
+        }
+        batches.push_back(std::move(batch));
+        return typed;
+    }
+
+    ThreadPool& Pool() {
+        if (!threadPool) {
+            threadPool.reset(new ThreadPool(std::max<int>(std::thread::hardware_concurrency(), 1)));
+        }
+        return *threadPool;
+    }
+
+    void ResetBatches() {
+        for (auto& batch : batches) {
+            freeBatches.push_back(std::move(batch));
+        }
+        batches.clear();
+    }
+
+    void FlushBins() {
+        // a triangle counts as rejected once every tile it was binned to rejected it
+        for (auto& batch : batches) {
+            batch->rejectedTiles.reset(new std::atomic<uint32_t>[batch->TriangleCount()]());
+        }
+
+        Pool().ParallelFor(tilesX * tilesY, [&](int tile) {
+            int tileX = (tile % tilesX) * TileSize,
+                    tileY = (tile / tilesX) * TileSize;
+            int tileMaxX = std::min(tileX + TileSize, framebuffer->Width()),
+                    tileMaxY = std::min(tileY + TileSize, framebuffer->Height());
+            uint64_t rejected = 0;
+            for (auto& batch : batches) {
+                rejected += batch->RasterTile(*this, tile, tileX, tileY, tileMaxX, tileMaxY);
+            }
+            tilesHiZRejected += rejected;
+
+            if (enableVisibilityBuffer || enableDeferred) {
+                ResolveTile(tile % tilesX, tile / tilesX);
+            }
+            PresentTile(tile % tilesX, tile / tilesX);
+        });
+        colorDirty = false;
+
+        for (auto& batch : batches) {
+            for (size_t i = 0; i < batch->TriangleCount(); i++) {
+                if (batch->rejectedTiles[i] == batch->triangleTiles[i]) {
+                    trianglesHiZRejected++;
+                }
+            }
+        }
+    }
+
+    // Color is kept tiled while rendering, this lays a tile out in the rows of the
+    // framebuffer, averaging the samples first under MSAA and tonemapping under HDR.
+    void PresentTile(int tx, int ty) {
+        int x0 = tx * TileSize, y0 = ty * TileSize,
+                x1 = std::min(x0 + TileSize, framebuffer->Width()),
+                y1 = std::min(y0 + TileSize, framebuffer->Height());
+        if (enableMultisample) {
+            multisampleBuffer->Resolve(*framebuffer, x0, y0, x1, y1);
+        } else if (enableHdr) {
+            framebuffer->ResolveHdr(*hdrBuffer, exposure, PackRGBA8(BG), x0, y0, x1, y1);
+        } else {
+            framebuffer->Detile(*colorBuffer, x0, y0, x1, y1);
+        }
+    }
+
+    // Shading pass of the visibility buffer over one tile, followed by the
+    // lighting pass of the G-buffer. Resolved pixels are reset, their IDs name
+    // batches that don't outlive this flush.
+    void ResolveTile(int tx, int ty) {
+        int maxX = std::min((tx + 1) * TileSize, framebuffer->Width()),
+                maxY = std::min((ty + 1) * TileSize, framebuffer->Height());
+        for (int j = ty * TileSize; j < maxY && enableVisibilityBuffer; j++) {
+            for (int i = tx * TileSize; i < maxX; i++) {
+                VisibilityID id = visibilityBuffer->Get(i, j);
+                if (id.drawID == InvalidDrawID) {
+                    continue;
+                }
+                batches[id.drawID]->ResolvePixel(*this, id.triangleID, i, j);
+                visibilityBuffer->Set(i, j, VisibilityID{InvalidDrawID, 0});
+            }
+        }
+        if (enableDeferred) {
+            LightTile(tx * TileSize, ty * TileSize, maxX, maxY);
+        }
+    }
+
+    // World space box around the G-buffer positions of [x0, x1) x [y0, y1),
+    // returns false when no pixel there was written.
+    bool SurfaceBounds(int x0, int y0, int x1, int y1, Vec3& min, Vec3& max) const {
+        bool found = false;
+        for (int j = y0; j < y1; j++) {
+            for (int i = x0; i < x1; i++) {
+                if (!gBuffer->Written(i, j)) {
                     continue;
                 }
+                const Vec3& p = gBuffer->Get(i, j).position;
+                if (!found) {
+                    min = max = p;
+                    found = true;
+                }
+                min = Vec3{std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+                max = Vec3{std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+            }
+        }
+        return found;
+    }
+
+    // Appends the lights of candidates whose sphere reaches the box to culled.
+    void CullLights(const std::vector<uint32_t>& candidates, const Vec3& min, const Vec3& max,
+                    std::vector<uint32_t>& culled) const {
+        for (uint32_t index : candidates) {
+            const PointLight& light = lights[index];
+            float d[3] = {std::max({min.x - light.Position.x, light.Position.x - max.x, 0.0f}),
+                          std::max({min.y - light.Position.y, light.Position.y - max.y, 0.0f}),
+                          std::max({min.z - light.Position.z, light.Position.z - max.z, 0.0f})};
+            if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] <= light.Radius * light.Radius) {
+                culled.push_back(index);
+            }
+        }
+    }
 
-/*                if (!insideTriangle(i, j, vertices)) {
+    // Viewer position for the specular term of the lighting pass, the eye of the
+    // newest draw of the flush with a uniform block. The draws of one flush are
+    // taken to share a camera, as the G-buffer doesn't say which draw wrote a texel.
+    Vec3 LightingEye() const {
+        for (auto it = batches.rbegin(); it != batches.rend(); ++it) {
+            if ((*it)->uniforms) {
+                return (*it)->uniforms->eye;
+            }
+        }
+        return Vec3{0, 0, 0};
+    }
+
+    // Lighting pass over one tile. The lights are culled against the bounds of
+    // the tile's surfaces first, then against those of each LightCullSize square.
+    // Lit texels are erased, so a later flush of the frame doesn't light them again.
+    void LightTile(int x0, int y0, int x1, int y1) {
+        Vec3 min, max;
+        if (!SurfaceBounds(x0, y0, x1, y1, min, max)) {
+            return;
+        }
+        std::vector<uint32_t> all(lights.size()), tileLights, cellLights;
+        for (uint32_t i = 0; i < all.size(); i++) {
+            all[i] = i;
+        }
+        CullLights(all, min, max, tileLights);
+
+        uint64_t pixels = 0, evaluated = 0;
+        for (int cy = y0; cy < y1; cy += LightCullSize) {
+            for (int cx = x0; cx < x1; cx += LightCullSize) {
+                int cx1 = std::min(cx + LightCullSize, x1), cy1 = std::min(cy + LightCullSize, y1);
+                if (!SurfaceBounds(cx, cy, cx1, cy1, min, max)) {
                     continue;
-                }*/
+                }
+                cellLights.clear();
+                CullLights(tileLights, min, max, cellLights);
+
+                for (int j = cy; j < cy1; j++) {
+                    for (int i = cx; i < cx1; i++) {
+                        if (gBuffer->Written(i, j)) {
+                            StoreColor(i, j, LightSurface(gBuffer->Get(i, j), cellLights, evaluated));
+                            gBuffer->Erase(i, j);
+                            pixels++;
+                        }
+                    }
+                }
+            }
+        }
+        litPixels += pixels;
+        lightsEvaluated += evaluated;
+    }
+
+    // Lighting of a G-buffer texel, the model of the forward spot shader summed
+    // over the given lights. Lights out of their radius add nothing and are skipped.
+    Color4 LightSurface(const GBufferTexel& surface, const std::vector<uint32_t>& lightIndices,
+                        uint64_t& evaluated) const {
+        Vec4 final(ambiColor);
+
+        if (enableLight) {
+            Vec4 ks = Vec4{surface.specular, surface.specular, surface.specular, 1.0f};
+            for (uint32_t index : lightIndices) {
+                const PointLight& light = lights[index];
+                if (!InRange(light, surface.position)) {
+                    continue;
+                }
+                final += PointLightShading(light, surface.position, surface.normal, lightingEye, ks,
+                                           surface.shininess, diffColor, specColor);
+                evaluated++;
+            }
+            if (!enableHdr) {
+                final.x = std::min(final.x, 1.0f);
+                final.y = std::min(final.y, 1.0f);
+                final.z = std::min(final.z, 1.0f);
+            }
+            final.w = 1.0f;
+        }
+
+        final *= surface.albedo;
+        if (enableHdr) {
+            return final;
+        }
+
+        float gamma = 0.454f;
+        final.x = std::pow(final.x, gamma);
+        final.y = std::pow(final.y, gamma);
+        final.z = std::pow(final.z, gamma);
+        return final;
+    }
+
+    bool OccludedByHiZ(float nearestZ, int tx, int ty) const {
+        return nearestZ + HiZEpsilon <= hiZBuffer->Tile(tx, ty);
+    }
+
+    bool OccludedByHiZ(float nearestZ, int minX, int minY, int maxX, int maxY) const {
+        for (int ty = minY / TileSize; ty <= (maxY - 1) / TileSize; ty++) {
+            for (int tx = minX / TileSize; tx <= (maxX - 1) / TileSize; tx++) {
+                if (!OccludedByHiZ(nearestZ, tx, ty)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Per triangle constants of the MSAA sample tests: the edge values of each
+    // sample relative to the pixel center and the vertex terms of the depth.
+    struct SampleSetup {
+        int64_t offset[3][MsaaSamples];
+        float rw[3];
+        float rwOverZ[3];
+        // change of both depth terms from the pixel center to each sample
+        float numeratorStep[MsaaSamples];
+        float denominatorStep[MsaaSamples];
+    };
+
+    // Walks the 8x8 blocks overlapping [minX, maxX) x [minY, maxY). Blocks outside
+    // one edge are skipped, blocks inside all three skip the per-pixel test.
+    template <typename V, typename FS>
+    void RasterizeTriangle(const TriangleT<V>& triangle, const FS& shader,
+                           int minX, int minY, int maxX, int maxY) {
+        const TriangleEdges& edges = triangle.edges;
+        const int last = RasterBlockSize - 1;
+
+        int64_t stepX[3], stepY[3], blockMin[3], blockMax[3];
+        SampleSetup setup = {};
+        for (int k = 0; k < 3; k++) {
+            stepX[k] = edges.a[k] * SubPixelScale;
+            stepY[k] = edges.b[k] * SubPixelScale;
+            blockMin[k] = std::min<int64_t>(stepX[k] * last, 0) + std::min<int64_t>(stepY[k] * last, 0);
+            blockMax[k] = std::max<int64_t>(stepX[k] * last, 0) + std::max<int64_t>(stepY[k] * last, 0);
+            if (enableMultisample) {
+                const VertexT<V>& vertex = (&triangle.v1)[k];
+                int64_t sampleMin = 0, sampleMax = 0;
+                for (int s = 0; s < MsaaSamples; s++) {
+                    setup.offset[k][s] = int64_t(edges.a[k]) * MsaaSampleOffsets[s][0] +
+                                         int64_t(edges.b[k]) * MsaaSampleOffsets[s][1];
+                    sampleMin = std::min(sampleMin, setup.offset[k][s]);
+                    sampleMax = std::max(sampleMax, setup.offset[k][s]);
+                }
+                blockMin[k] += sampleMin;
+                blockMax[k] += sampleMax;
+                setup.rw[k] = vertex.rw;
+                setup.rwOverZ[k] = vertex.rw / vertex.pos3.z;
+            }
+        }
+        for (int s = 0; s < MsaaSamples && enableMultisample; s++) {
+            for (int k = 0; k < 3; k++) {
+                setup.numeratorStep[s] += float(setup.offset[k][s]) * setup.rw[k];
+                setup.denominatorStep[s] += float(setup.offset[k][s]) * setup.rwOverZ[k];
+            }
+        }
+
+        const bool wide = HasWideShader<FS>::value && enableSimdFragments && !enableVisibilityBuffer &&
+                          !(HasSurfaceShader<FS>::value && enableDeferred);
+
+        uint64_t rejected = 0, cleared = 0;
+        for (int by = minY & ~last; by < maxY; by += RasterBlockSize) {
+            for (int bx = minX & ~last; bx < maxX; bx += RasterBlockSize) {
+                if (enableDepthTest &&
+                    triangle.nearestZ + HiZEpsilon <= hiZBuffer->Block(bx / RasterBlockSize, by / RasterBlockSize)) {
+                    rejected++;
+                    continue;
+                }
+
+                bool outside = false, covered = true;
+                for (int k = 0; k < 3; k++) {
+                    int64_t e = EvaluateEdge(edges, k, bx, by);
+                    if (e + blockMax[k] < 0) {
+                        outside = true;
+                        break;
+                    }
+                    covered &= e + blockMin[k] >= 0;
+                }
+                if (outside) {
+                    continue;
+                }
+                cleared += TouchBlock(bx, by);
+
+                int x0 = std::max(bx, minX), x1 = std::min(bx + RasterBlockSize, maxX),
+                        y0 = std::max(by, minY), y1 = std::min(by + RasterBlockSize, maxY);
+                int64_t row[3] = {EvaluateEdge(edges, 0, x0, y0),
+                                  EvaluateEdge(edges, 1, x0, y0),
+                                  EvaluateEdge(edges, 2, x0, y0)};
+                bool written = false;
+                for (int j = y0; j < y1; j++) {
+                    if (wide) {
+                        written |= ShadeSpan(triangle, shader, x0, x1, j, row, stepX, setup, covered);
+                    } else {
+                        int64_t e0 = row[0], e1 = row[1], e2 = row[2];
+                        for (int i = x0; i < x1; i++) {
+                            if (enableMultisample) {
+                                written |= ShadeSamples(triangle, shader, i, j, e0, e1, e2, setup, covered);
+                            } else if (covered || (e0 | e1 | e2) >= 0) {
+                                written |= ShadePixel(triangle, shader, i, j, e0, e1, e2);
+                            }
+                            e0 += stepX[0];
+                            e1 += stepX[1];
+                            e2 += stepX[2];
+                        }
+                    }
+                    row[0] += stepY[0];
+                    row[1] += stepY[1];
+                    row[2] += stepY[2];
+                }
+
+                if (written && enableDepthTest) {
+                    hiZBuffer->UpdateBlock(*depthBuffer, bx / RasterBlockSize, by / RasterBlockSize);
+                }
+            }
+        }
+        blocksHiZRejected += rejected;
+        blocksCleared += cleared;
+    }
+
+    // Makes the depth and color of the block at (x, y) resident before the
+    // rasterizer writes it, returns whether they had to be filled.
+    bool TouchBlock(int x, int y) {
+        bool cleared = depthBuffer->Touch(x, y);
+        if (enableMultisample) {
+            cleared |= multisampleBuffer->Touch(x, y);
+        } else if (enableHdr) {
+            cleared |= hdrBuffer->Touch(x, y);
+        } else {
+            cleared |= colorBuffer->Touch(x, y);
+        }
+        return cleared;
+    }
+
+    // Perspective-correct barycentrics and depth of a pixel from its edge values.
+    template <typename V>
+    float InterpolateDepth(const TriangleT<V>& triangle, int64_t e0, int64_t e1, int64_t e2, Vec3& barycentric) const {
+        const VertexT<V>* v = &triangle.v1;
+        const TriangleEdges& edges = triangle.edges;
+
+        float invArea = 1.0f / float(edges.area);
+        barycentric = Vec3{float(e0 + edges.bias[0]) * invArea,
+                           float(e1 + edges.bias[1]) * invArea,
+                           float(e2 + edges.bias[2]) * invArea};
+
+        float rw = v[0].rw * barycentric.alpha + v[1].rw * barycentric.beta + v[2].rw * barycentric.gamma;
+        float w = 1.0f / ((rw != 0.0f)? rw : 1.0f);
+
+        barycentric.alpha *= v[0].rw * w;
+        barycentric.beta *= v[1].rw * w;
+        barycentric.gamma *= v[2].rw * w;
+
+        return 1.0 / (barycentric.alpha / v[0].pos3.z + barycentric.beta / v[1].pos3.z + barycentric.gamma / v[2].pos3.z);
+    }
 
-                float rw = vertices[0].rw * barycentric.alpha + vertices[1].rw * barycentric.beta + vertices[2].rw * barycentric.gamma;
-                float w = 1.0f / ((rw != 0.0f)? rw : 1.0f);
+    // Perspective-correct barycentrics of a SoA batch from its edge values plus bias.
+    template <typename V>
+    void PerspectiveWeights8(const TriangleT<V>& triangle, const float (&weight)[3][SimdWidth],
+                             Float8& alpha, Float8& beta, Float8& gamma) const {
+        const VertexT<V>* v = &triangle.v1;
+        Float8 invArea = 1.0f / float(triangle.edges.area);
+        alpha = Float8::Load(weight[0]) * invArea;
+        beta = Float8::Load(weight[1]) * invArea;
+        gamma = Float8::Load(weight[2]) * invArea;
+
+        Float8 rw = Float8(v[0].rw) * alpha + Float8(v[1].rw) * beta + Float8(v[2].rw) * gamma;
+        Float8 w = Float8(1.0f) / NonZeroOr(rw, 1.0f);
+        alpha *= Float8(v[0].rw) * w;
+        beta *= Float8(v[1].rw) * w;
+        gamma *= Float8(v[2].rw) * w;
+    }
+
+    // Quad derivatives of the varyings of the SimdWidth pixels from (x0, j) on.
+    // Edge functions are linear, so the quad neighbours of a pixel are evaluated
+    // whether or not they are inside the triangle.
+    template <typename V, typename V8>
+    void QuadDerivatives8(const TriangleT<V>& triangle, int x0, int j, QuadDerivatives<V8>& derivatives) const {
+        const VertexT<V>* v = &triangle.v1;
+        const TriangleEdges& edges = triangle.edges;
+
+        // the top-left, top-right and bottom-left pixels of each lane's quad
+        alignas(32) float weight[3][3][SimdWidth];
+        for (int lane = 0; lane < SimdWidth; lane++) {
+            int qx = (x0 + lane) & ~1, qy = j & ~1;
+            for (int k = 0; k < 3; k++) {
+                int64_t e = EvaluateEdge(edges, k, qx, qy) + edges.bias[k];
+                weight[0][k][lane] = float(e);
+                weight[1][k][lane] = float(e + edges.a[k] * SubPixelScale);
+                weight[2][k][lane] = float(e + edges.b[k] * SubPixelScale);
+            }
+        }
+        Float8 b[3][3];
+        for (int corner = 0; corner < 3; corner++) {
+            PerspectiveWeights8(triangle, weight[corner], b[corner][0], b[corner][1], b[corner][2]);
+        }
+        InterpolateVaryings8(v[0].varyings, v[1].varyings, v[2].varyings, b[1][0] - b[0][0], b[1][1] - b[0][1],
+                             b[1][2] - b[0][2], derivatives.ddx);
+        InterpolateVaryings8(v[0].varyings, v[1].varyings, v[2].varyings, b[2][0] - b[0][0], b[2][1] - b[0][1],
+                             b[2][2] - b[0][2], derivatives.ddy);
+    }
 
-                barycentric.alpha *= vertices[0].rw * w;
-                barycentric.beta *= vertices[1].rw * w;
-                barycentric.gamma *= vertices[2].rw * w;
+    // scalar counterpart of QuadDerivatives8 for pixel (i, j)
+    template <typename V>
+    void QuadDerivativesAt(const TriangleT<V>& triangle, int i, int j, QuadDerivatives<V>& derivatives) const {
+        const TriangleEdges& edges = triangle.edges;
+        int qx = i & ~1, qy = j & ~1;
+        int64_t e[3];
+        for (int k = 0; k < 3; k++) {
+            e[k] = EvaluateEdge(edges, k, qx, qy);
+        }
+        Vec3 origin, right, down;
+        InterpolateDepth(triangle, e[0], e[1], e[2], origin);
+        InterpolateDepth(triangle, e[0] + edges.a[0] * SubPixelScale, e[1] + edges.a[1] * SubPixelScale,
+                         e[2] + edges.a[2] * SubPixelScale, right);
+        InterpolateDepth(triangle, e[0] + edges.b[0] * SubPixelScale, e[1] + edges.b[1] * SubPixelScale,
+                         e[2] + edges.b[2] * SubPixelScale, down);
+        InterpolateVaryings(triangle.v1.varyings, triangle.v2.varyings, triangle.v3.varyings, right - origin, derivatives.ddx);
+        InterpolateVaryings(triangle.v1.varyings, triangle.v2.varyings, triangle.v3.varyings, down - origin, derivatives.ddy);
+    }
+
+    // Shades pixels [x0, x1) of row j, at most SimdWidth of them, as one SoA batch.
+    // Lanes outside the triangle or failing the depth test are masked off before
+    // anything is written. Returns whether the depth buffer was written.
+    template <typename V, typename FS>
+    bool ShadeSpan(const TriangleT<V>& triangle, const FS& shader, int x0, int x1, int j,
+                   const int64_t (&row)[3], const int64_t (&stepX)[3],
+                   const SampleSetup& setup, bool covered) {
+        static_assert(RasterBlockSize <= SimdWidth, "a block row must fit in one SIMD batch");
+        if constexpr (!HasWideShader<FS>::value) {
+            return false;
+        } else {
+            const VertexT<V>* v = &triangle.v1;
+            const TriangleEdges& edges = triangle.edges;
+
+            alignas(32) float weight[3][SimdWidth] = {};
+            int64_t e[3] = {row[0], row[1], row[2]};
+            uint32_t mask = 0, samples[SimdWidth] = {};
+            for (int lane = 0; lane < x1 - x0; lane++) {
+                if (enableMultisample) {
+                    samples[lane] = SampleCoverage(e[0], e[1], e[2], setup, covered);
+                    if (samples[lane]) {
+                        mask |= 1u << lane;
+                    }
+                } else if (covered || (e[0] | e[1] | e[2]) >= 0) {
+                    mask |= 1u << lane;
+                }
+                for (int k = 0; k < 3; k++) {
+                    weight[k][lane] = float(e[k] + edges.bias[k]);
+                    e[k] += stepX[k];
+                }
+            }
+            if (!mask) {
+                return false;
+            }
 
-                if (barycentric.alpha < 0 && barycentric.beta < 0 && barycentric.gamma < 0) {
+            if (enableMultisample && enableDepthTest) {
+                Float8 numerator = Float8::Load(weight[0]) * setup.rw[0] + Float8::Load(weight[1]) * setup.rw[1] +
+                                   Float8::Load(weight[2]) * setup.rw[2];
+                Float8 denominator = Float8::Load(weight[0]) * setup.rwOverZ[0] +
+                                     Float8::Load(weight[1]) * setup.rwOverZ[1] +
+                                     Float8::Load(weight[2]) * setup.rwOverZ[2];
+                alignas(32) float depth[MsaaSamples][SimdWidth];
+                for (int s = 0; s < MsaaSamples; s++) {
+                    Float8 z = (numerator + setup.numeratorStep[s]) / (denominator + setup.denominatorStep[s]);
+                    z.Store(depth[s]);
+                }
+                for (int lane = 0; lane < x1 - x0; lane++) {
+                    if (samples[lane]) {
+                        samples[lane] = TestSampleDepth(x0 + lane, j, samples[lane], &depth[0][lane], SimdWidth);
+                        if (!samples[lane]) {
+                            mask &= ~(1u << lane);
+                        }
+                    }
+                }
+                if (!mask) {
                     return false;
                 }
+            }
 
-                float z = 1.0 / (barycentric.alpha / vertices[0].pos3.z + barycentric.beta / vertices[1].pos3.z + barycentric.gamma / vertices[2].pos3.z);
+            Float8 alpha, beta, gamma;
+            PerspectiveWeights8(triangle, weight, alpha, beta, gamma);
 
-                if (enableDepthTest) {
-                    if (z <= depthBuffer->Get(i, j)) {
+            Float8 z = Float8(1.0f) / (alpha / v[0].pos3.z + beta / v[1].pos3.z + gamma / v[2].pos3.z);
+            if (enableDepthTest && !enableMultisample) {
+                alignas(32) float depth[SimdWidth];
+                z.Store(depth);
+                float* stored = depthBuffer->Span(x0, j);
+                for (int lane = 0; lane < x1 - x0; lane++) {
+                    if (!(mask & (1u << lane))) {
                         continue;
                     }
-                    depthBuffer->Set(i, j, z);
+                    if (depth[lane] <= stored[lane]) {
+                        mask &= ~(1u << lane);
+                    } else {
+                        stored[lane] = depth[lane];
+                    }
+                }
+                if (!mask) {
+                    return false;
                 }
+            }
 
-                ShaderContext input;
-                ShaderContext& c0 = vertices[0].context,
-                        c1 = vertices[1].context,
-                        c2 = vertices[2].context;
-                for (auto& [key, value] : c0.varyingFloat) {
-                    input.varyingFloat[key] = c0.varyingFloat[key] * barycentric.alpha +
-                                              c1.varyingFloat[key] * barycentric.beta +
-                                              c2.varyingFloat[key] * barycentric.gamma;
+            typename FS::Varyings8 input;
+            InterpolateVaryings8(v[0].varyings, v[1].varyings, v[2].varyings, alpha, beta, gamma, input);
+            Vec4x8 color;
+            if constexpr (HasQuadShader<FS>::value) {
+                if (NeedsQuadDerivatives(shader)) {
+                    QuadDerivatives<typename FS::Varyings8> derivatives;
+                    QuadDerivatives8(triangle, x0, j, derivatives);
+                    color = shader(input, derivatives, mask);
+                } else {
+                    color = shader(input, mask);
                 }
-                for (auto& [key, value] : c0.varyingVec2) {
-                    input.varyingVec2[key] = c0.varyingVec2[key] * barycentric.alpha +
-                                             c1.varyingVec2[key] * barycentric.beta +
-                                             c2.varyingVec2[key] * barycentric.gamma;
+            } else {
+                color = shader(input, mask);
+            }
+
+            if (enableHdr) {
+                alignas(32) float r[SimdWidth], g[SimdWidth], b[SimdWidth], a[SimdWidth];
+                color.x.Store(r);
+                color.y.Store(g);
+                color.z.Store(b);
+                color.w.Store(a);
+                for (int lane = 0; lane < x1 - x0; lane++) {
+                    if (mask & (1u << lane)) {
+                        WritePixel(x0 + lane, j, Color4{r[lane], g[lane], b[lane], a[lane]}, samples[lane]);
+                    }
                 }
-                for (auto& [key, value] : c0.varyingVec3) {
-                    input.varyingVec3[key] = c0.varyingVec3[key] * barycentric.alpha +
-                                             c1.varyingVec3[key] * barycentric.beta +
-                                             c2.varyingVec3[key] * barycentric.gamma;
+                return enableDepthTest;
+            }
+
+            Uint32 packed[SimdWidth];
+            PackRGBA8(color, packed);
+            Uint32* row = colorBuffer->Span(x0, j);
+            for (int lane = 0; lane < x1 - x0; lane++) {
+                if (!(mask & (1u << lane))) {
+                    continue;
                 }
-                for (auto& [key, value] : c0.varyingVec4) {
-                    input.varyingVec4[key] = c0.varyingVec4[key] * barycentric.alpha +
-                                             c1.varyingVec4[key] * barycentric.beta +
-                                             c2.varyingVec4[key] * barycentric.gamma;
+                if (enableMultisample || enableDeferred) {
+                    WritePixel(x0 + lane, j, packed[lane], samples[lane]);
+                } else {
+                    row[lane] = packed[lane];
                 }
+            }
+            return enableDepthTest;
+        }
+    }
 
+    // returns whether the depth buffer was written
+    template <typename V, typename FS>
+    bool ShadePixel(const TriangleT<V>& triangle, const FS& shader,
+                    int i, int j, int64_t e0, int64_t e1, int64_t e2) {
+        Vec3 barycentric;
+        float z = InterpolateDepth(triangle, e0, e1, e2, barycentric);
 
+        if (enableDepthTest) {
+            if (z <= depthBuffer->Get(i, j)) {
+                return false;
+            }
+            depthBuffer->Set(i, j, z);
+        }
+
+        if (enableVisibilityBuffer) {
+            visibilityBuffer->Set(i, j, VisibilityID{triangle.drawID, triangle.triangleID});
+        } else {
+            ShadeFragment(triangle, shader, i, j, barycentric);
+        }
+        return enableDepthTest;
+    }
+
+    // mask of the samples of the pixel whose center has the edge values e0, e1, e2
+    uint32_t SampleCoverage(int64_t e0, int64_t e1, int64_t e2, const SampleSetup& setup, bool covered) const {
+        if (covered) {
+            return (1u << MsaaSamples) - 1;
+        }
+        uint32_t mask = 0;
+        for (int s = 0; s < MsaaSamples; s++) {
+            if (((e0 + setup.offset[0][s]) | (e1 + setup.offset[1][s]) | (e2 + setup.offset[2][s])) >= 0) {
+                mask |= 1u << s;
+            }
+        }
+        return mask;
+    }
 
-                Vec4 color{0, 0, 0, 0};
-                if (fragmentShader) {
-                    color = fragmentShader(input);
-                    framebuffer->PutPixel(i, j, color);
+    // Depth test of the covered samples of pixel (i, j) against depth[s * stride].
+    // Writes the samples that pass and returns their mask. The depth buffer keeps
+    // the farthest sample of the pixel, which is what Hi-Z needs.
+    uint32_t TestSampleDepth(int i, int j, uint32_t coverage, const float* depth, int stride) {
+        float* stored = multisampleBuffer->Depth(i, j);
+        uint32_t mask = 0;
+        for (int s = 0; s < MsaaSamples; s++) {
+            if ((coverage & (1u << s)) && depth[s * stride] > stored[s]) {
+                stored[s] = depth[s * stride];
+                mask |= 1u << s;
+            }
+        }
+        if (mask) {
+            depthBuffer->Set(i, j, *std::min_element(stored, stored + MsaaSamples));
+        }
+        return mask;
+    }
+
+    // Coverage and depth test of the samples of pixel (i, j), returns the mask of
+    // the samples that pass.
+    template <typename V>
+    uint32_t TestSamples(const TriangleT<V>& triangle, int i, int j, int64_t e0, int64_t e1, int64_t e2,
+                         const SampleSetup& setup, bool covered) {
+        uint32_t coverage = SampleCoverage(e0, e1, e2, setup, covered);
+        if (!coverage || !enableDepthTest) {
+            return coverage;
+        }
+
+        // the depth of InterpolateDepth with the area and w factors cancelled, both
+        // terms are linear in screen space
+        const TriangleEdges& edges = triangle.edges;
+        float w0 = float(e0 + edges.bias[0]), w1 = float(e1 + edges.bias[1]), w2 = float(e2 + edges.bias[2]);
+        float numerator = w0 * setup.rw[0] + w1 * setup.rw[1] + w2 * setup.rw[2],
+                denominator = w0 * setup.rwOverZ[0] + w1 * setup.rwOverZ[1] + w2 * setup.rwOverZ[2];
+        float depth[MsaaSamples];
+        for (int s = 0; s < MsaaSamples; s++) {
+            depth[s] = (numerator + setup.numeratorStep[s]) / (denominator + setup.denominatorStep[s]);
+        }
+        return TestSampleDepth(i, j, coverage, depth, 1);
+    }
+
+    // MSAA counterpart of ShadePixel, the shader runs at the pixel center
+    template <typename V, typename FS>
+    bool ShadeSamples(const TriangleT<V>& triangle, const FS& shader, int i, int j, int64_t e0, int64_t e1, int64_t e2,
+                      const SampleSetup& setup, bool covered) {
+        uint32_t samples = TestSamples(triangle, i, j, e0, e1, e2, setup, covered);
+        if (!samples) {
+            return false;
+        }
+        Vec3 barycentric;
+        InterpolateDepth(triangle, e0, e1, e2, barycentric);
+        ShadeFragment(triangle, shader, i, j, barycentric, samples);
+        return enableDepthTest;
+    }
+
+    template <typename V, typename FS>
+    void ShadeFragment(const TriangleT<V>& triangle, const FS& shader,
+                       int i, int j, const Vec3& barycentric, uint32_t samples = (1u << MsaaSamples) - 1) {
+        if (!IsShaderSet(shader)) {
+            return;
+        }
+        V input;
+        InterpolateVaryings(triangle.v1.varyings, triangle.v2.varyings, triangle.v3.varyings, barycentric, input);
+        if constexpr (HasQuadShader<FS>::value) {
+            if (NeedsQuadDerivatives(shader)) {
+                QuadDerivatives<V> derivatives;
+                QuadDerivativesAt(triangle, i, j, derivatives);
+                if constexpr (HasSurfaceShader<FS>::value) {
+                    if (enableDeferred) {
+                        GBufferTexel texel;
+                        shader(input, derivatives, texel);
+                        gBuffer->Set(i, j, texel);
+                        return;
+                    }
                 }
+                WritePixel(i, j, shader(input, derivatives), samples);
+                return;
             }
         }
-        return true;
+        if constexpr (HasSurfaceShader<FS>::value) {
+            if (enableDeferred) {
+                GBufferTexel texel;
+                shader(input, texel);
+                gBuffer->Set(i, j, texel);
+                return;
+            }
+        }
+        WritePixel(i, j, shader(input), samples);
     }
 
-private:
+    // linear color under HDR, otherwise the RGBA8 encoding of the shader output
+    void WritePixel(int i, int j, const Color4& color, uint32_t samples) {
+        if (!enableHdr) {
+            WritePixel(i, j, PackRGBA8(color), samples);
+            return;
+        }
+        if (enableDeferred) {
+            gBuffer->Erase(i, j);
+        }
+        StoreColor(i, j, color);
+    }
+
+    // color of a pixel of the single sampled targets
+    void StoreColor(int i, int j, const Color4& color) {
+        if (enableHdr) {
+            hdrBuffer->Touch(i, j);
+            hdrBuffer->Set(i, j, color);
+        } else {
+            colorBuffer->Touch(i, j);
+            colorBuffer->Set(i, j, PackRGBA8(color));
+        }
+    }
+
+    // Writes an RGBA8 pixel, samples is the set of MSAA samples to write, unused
+    // without multisampling.
+    void WritePixel(int i, int j, Uint32 pixel, uint32_t samples) {
+        if (enableDeferred) {
+            gBuffer->Erase(i, j);
+        }
+        if (!enableMultisample) {
+            colorBuffer->Touch(i, j);
+            colorBuffer->Set(i, j, pixel);
+            return;
+        }
+        multisampleBuffer->Touch(i, j);
+        Uint32* target = multisampleBuffer->Color(i, j);
+        for (int s = 0; s < MsaaSamples; s++) {
+            if (samples & (1u << s)) {
+                target[s] = pixel;
+            }
+        }
+    }
 
-    Vertex vertices[3];
     std::shared_ptr<FrameBuffer> framebuffer;
     Color4 drawColor;
     Color4 ambiColor;
@@ -346,14 +1532,54 @@ private:
 
     VertexShader vertexShader = nullptr;
     FragmentShader fragmentShader = nullptr;
+    TiledBuffer<Uint32>* colorBuffer = nullptr;
     Buffer2D* depthBuffer = nullptr;
-    Mat4x4 viewport;
+    HiZBuffer* hiZBuffer = nullptr;
+    VisibilityBuffer* visibilityBuffer = nullptr;
+    MultisampleBuffer* multisampleBuffer = nullptr;
+    TiledBuffer<Color4>* hdrBuffer = nullptr;
+    GBuffer* gBuffer = nullptr;
+    std::vector<PointLight> lights;
+    Vec3 lightingEye = Vec3{0, 0, 0};
+    std::shared_ptr<const Uniforms> uniforms;
+    uint64_t uniformsVersion = 0;
+    Mat4x4 viewport = Mat4x4::Eye();
+    Vec4 clipPlanes[ClipPlaneCount];
+    float clipSign = 1.0f;
     FaceCull faceCull = CCW;
     bool enableFaceCull = true;
     bool enableDepthTest = true;
     bool enableLight = false;
     bool enableTexture = false;
     bool onlyDrawLine = false;
+    bool enableBinning = false;
+    bool enableVisibilityBuffer = false;
+    bool enableSimdFragments = true;
+    bool enableMultisample = false;
+    bool enableHdr = false;
+    float exposure = 1.0f;
+    // the color or multisample buffer changed since Flush last copied it out
+    bool colorDirty = false;
+    bool enableDeferred = false;
+
+    std::unique_ptr<ThreadPool> threadPool;
+    // draw calls since the last Flush, indexed by drawID
+    std::vector<std::unique_ptr<DrawBatch>> batches;
+    std::vector<std::unique_ptr<DrawBatch>> freeBatches;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    std::atomic<uint64_t> trianglesHiZRejected{0};
+    std::atomic<uint64_t> tilesHiZRejected{0};
+    std::atomic<uint64_t> blocksHiZRejected{0};
+    std::atomic<uint64_t> blocksCleared{0};
+    std::atomic<uint64_t> litPixels{0};
+    std::atomic<uint64_t> lightsEvaluated{0};
+    double clearMs = 0;
+
+    int vertexCacheSize = 0;
+    uint64_t vertexCacheHits = 0;
+    uint64_t vertexCacheMisses = 0;
 };
 
 